@@ -5,6 +5,425 @@
 
 using namespace Rcpp;
 
+// xbgcnbd_ll_cpp
+NumericVector xbgcnbd_ll_cpp(NumericVector params, NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector litt, bool dropout_at_zero, int threads);
+RcppExport SEXP _BTYDplus_xbgcnbd_ll_cpp(SEXP paramsSEXP, SEXP xSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP littSEXP, SEXP dropout_at_zeroSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type params(paramsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type tx(txSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tcal(TcalSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type litt(littSEXP);
+    Rcpp::traits::input_parameter< bool >::type dropout_at_zero(dropout_at_zeroSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xbgcnbd_ll_cpp(params, x, tx, Tcal, litt, dropout_at_zero, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// xbgcnbd_ll_grad_cpp
+List xbgcnbd_ll_grad_cpp(NumericVector params, NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector litt, bool dropout_at_zero, int threads, NumericVector weights);
+RcppExport SEXP _BTYDplus_xbgcnbd_ll_grad_cpp(SEXP paramsSEXP, SEXP xSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP littSEXP, SEXP dropout_at_zeroSEXP, SEXP threadsSEXP, SEXP weightsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type params(paramsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type tx(txSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tcal(TcalSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type litt(littSEXP);
+    Rcpp::traits::input_parameter< bool >::type dropout_at_zero(dropout_at_zeroSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type weights(weightsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xbgcnbd_ll_grad_cpp(params, x, tx, Tcal, litt, dropout_at_zero, threads, weights));
+    return rcpp_result_gen;
+END_RCPP
+}
+// customer_state_create
+SEXP customer_state_create(DataFrame cbs);
+RcppExport SEXP _BTYDplus_customer_state_create(SEXP cbsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< DataFrame >::type cbs(cbsSEXP);
+    rcpp_result_gen = Rcpp::wrap(customer_state_create(cbs));
+    return rcpp_result_gen;
+END_RCPP
+}
+// customer_state_set
+void customer_state_set(SEXP state, String what, NumericVector values);
+RcppExport SEXP _BTYDplus_customer_state_set(SEXP stateSEXP, SEXP whatSEXP, SEXP valuesSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< String >::type what(whatSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type values(valuesSEXP);
+    customer_state_set(state, what, values);
+    return R_NilValue;
+END_RCPP
+}
+// customer_state_get
+NumericVector customer_state_get(SEXP state, String what);
+RcppExport SEXP _BTYDplus_customer_state_get(SEXP stateSEXP, SEXP whatSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< String >::type what(whatSEXP);
+    rcpp_result_gen = Rcpp::wrap(customer_state_get(state, what));
+    return rcpp_result_gen;
+END_RCPP
+}
+// draw_store_create
+void draw_store_create(std::string path, IntegerVector dims, bool single);
+RcppExport SEXP _BTYDplus_draw_store_create(SEXP pathSEXP, SEXP dimsSEXP, SEXP singleSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type dims(dimsSEXP);
+    Rcpp::traits::input_parameter< bool >::type single(singleSEXP);
+    draw_store_create(path, dims, single);
+    return R_NilValue;
+END_RCPP
+}
+// draw_store_single
+IntegerVector draw_store_single(NumericVector values);
+RcppExport SEXP _BTYDplus_draw_store_single(SEXP valuesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type values(valuesSEXP);
+    rcpp_result_gen = Rcpp::wrap(draw_store_single(values));
+    return rcpp_result_gen;
+END_RCPP
+}
+// draw_store_open
+SEXP draw_store_open(std::string path, bool writable);
+RcppExport SEXP _BTYDplus_draw_store_open(SEXP pathSEXP, SEXP writableSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< bool >::type writable(writableSEXP);
+    rcpp_result_gen = Rcpp::wrap(draw_store_open(path, writable));
+    return rcpp_result_gen;
+END_RCPP
+}
+// draw_store_close
+void draw_store_close(SEXP store);
+RcppExport SEXP _BTYDplus_draw_store_close(SEXP storeSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    draw_store_close(store);
+    return R_NilValue;
+END_RCPP
+}
+// draw_store_is_open
+bool draw_store_is_open(SEXP store);
+RcppExport SEXP _BTYDplus_draw_store_is_open(SEXP storeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    rcpp_result_gen = Rcpp::wrap(draw_store_is_open(store));
+    return rcpp_result_gen;
+END_RCPP
+}
+// draw_store_dim
+IntegerVector draw_store_dim(SEXP store);
+RcppExport SEXP _BTYDplus_draw_store_dim(SEXP storeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    rcpp_result_gen = Rcpp::wrap(draw_store_dim(store));
+    return rcpp_result_gen;
+END_RCPP
+}
+// draw_store_write_chain
+void draw_store_write_chain(SEXP store, NumericVector values, int chain);
+RcppExport SEXP _BTYDplus_draw_store_write_chain(SEXP storeSEXP, SEXP valuesSEXP, SEXP chainSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type values(valuesSEXP);
+    Rcpp::traits::input_parameter< int >::type chain(chainSEXP);
+    draw_store_write_chain(store, values, chain);
+    return R_NilValue;
+END_RCPP
+}
+// draw_store_matrix
+NumericMatrix draw_store_matrix(SEXP store, int param, IntegerVector idx, int offset);
+RcppExport SEXP _BTYDplus_draw_store_matrix(SEXP storeSEXP, SEXP paramSEXP, SEXP idxSEXP, SEXP offsetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type param(paramSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type idx(idxSEXP);
+    Rcpp::traits::input_parameter< int >::type offset(offsetSEXP);
+    rcpp_result_gen = Rcpp::wrap(draw_store_matrix(store, param, idx, offset));
+    return rcpp_result_gen;
+END_RCPP
+}
+// draw_store_mean
+NumericVector draw_store_mean(SEXP store, int param, int offset);
+RcppExport SEXP _BTYDplus_draw_store_mean(SEXP storeSEXP, SEXP paramSEXP, SEXP offsetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type param(paramSEXP);
+    Rcpp::traits::input_parameter< int >::type offset(offsetSEXP);
+    rcpp_result_gen = Rcpp::wrap(draw_store_mean(store, param, offset));
+    return rcpp_result_gen;
+END_RCPP
+}
+// draw_store_customer
+NumericVector draw_store_customer(SEXP store, int cust, int offset);
+RcppExport SEXP _BTYDplus_draw_store_customer(SEXP storeSEXP, SEXP custSEXP, SEXP offsetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type cust(custSEXP);
+    Rcpp::traits::input_parameter< int >::type offset(offsetSEXP);
+    rcpp_result_gen = Rcpp::wrap(draw_store_customer(store, cust, offset));
+    return rcpp_result_gen;
+END_RCPP
+}
+// elog2cbs_cpp
+List elog2cbs_cpp(SEXP cust, NumericVector date, NumericVector sales, IntegerVector ord, double mult, double unit, double Tcal, double Ttot);
+RcppExport SEXP _BTYDplus_elog2cbs_cpp(SEXP custSEXP, SEXP dateSEXP, SEXP salesSEXP, SEXP ordSEXP, SEXP multSEXP, SEXP unitSEXP, SEXP TcalSEXP, SEXP TtotSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cust(custSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type date(dateSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sales(salesSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type ord(ordSEXP);
+    Rcpp::traits::input_parameter< double >::type mult(multSEXP);
+    Rcpp::traits::input_parameter< double >::type unit(unitSEXP);
+    Rcpp::traits::input_parameter< double >::type Tcal(TcalSEXP);
+    Rcpp::traits::input_parameter< double >::type Ttot(TtotSEXP);
+    rcpp_result_gen = Rcpp::wrap(elog2cbs_cpp(cust, date, sales, ord, mult, unit, Tcal, Ttot));
+    return rcpp_result_gen;
+END_RCPP
+}
+// elog2cbs_update_cpp
+List elog2cbs_update_cpp(SEXP cust, NumericVector date, NumericVector sales, IntegerVector ord, IntegerVector pos, double mult, double unit, double Tcal, NumericVector first, NumericVector cbs_x, NumericVector cbs_tx, NumericVector cbs_litt, NumericVector cbs_sales, NumericVector cbs_sales_x);
+RcppExport SEXP _BTYDplus_elog2cbs_update_cpp(SEXP custSEXP, SEXP dateSEXP, SEXP salesSEXP, SEXP ordSEXP, SEXP posSEXP, SEXP multSEXP, SEXP unitSEXP, SEXP TcalSEXP, SEXP firstSEXP, SEXP cbs_xSEXP, SEXP cbs_txSEXP, SEXP cbs_littSEXP, SEXP cbs_salesSEXP, SEXP cbs_sales_xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cust(custSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type date(dateSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sales(salesSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type ord(ordSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type pos(posSEXP);
+    Rcpp::traits::input_parameter< double >::type mult(multSEXP);
+    Rcpp::traits::input_parameter< double >::type unit(unitSEXP);
+    Rcpp::traits::input_parameter< double >::type Tcal(TcalSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type first(firstSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type cbs_x(cbs_xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type cbs_tx(cbs_txSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type cbs_litt(cbs_littSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type cbs_sales(cbs_salesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type cbs_sales_x(cbs_sales_xSEXP);
+    rcpp_result_gen = Rcpp::wrap(elog2cbs_update_cpp(cust, date, sales, ord, pos, mult, unit, Tcal, first, cbs_x, cbs_tx, cbs_litt, cbs_sales, cbs_sales_x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cbs_unique_cpp
+List cbs_unique_cpp(List cols);
+RcppExport SEXP _BTYDplus_cbs_unique_cpp(SEXP colsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type cols(colsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cbs_unique_cpp(cols));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mcmc_draw_future_transactions_cpp
+NumericMatrix mcmc_draw_future_transactions_cpp(NumericVector tx, NumericVector Tcal, NumericVector Tstar, NumericMatrix tau, NumericMatrix k, NumericMatrix lambda, int sample_size, int threads);
+RcppExport SEXP _BTYDplus_mcmc_draw_future_transactions_cpp(SEXP txSEXP, SEXP TcalSEXP, SEXP TstarSEXP, SEXP tauSEXP, SEXP kSEXP, SEXP lambdaSEXP, SEXP sample_sizeSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type tx(txSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tcal(TcalSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tstar(TstarSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type tau(tauSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type k(kSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type lambda(lambdaSEXP);
+    Rcpp::traits::input_parameter< int >::type sample_size(sample_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mcmc_draw_future_transactions_cpp(tx, Tcal, Tstar, tau, k, lambda, sample_size, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mcmc_summarize_future_transactions_cpp
+NumericMatrix mcmc_summarize_future_transactions_cpp(NumericVector tx, NumericVector Tcal, NumericVector Tstar, NumericMatrix tau, NumericMatrix k, NumericMatrix lambda, NumericVector probs, int censor, int sample_size, int threads);
+RcppExport SEXP _BTYDplus_mcmc_summarize_future_transactions_cpp(SEXP txSEXP, SEXP TcalSEXP, SEXP TstarSEXP, SEXP tauSEXP, SEXP kSEXP, SEXP lambdaSEXP, SEXP probsSEXP, SEXP censorSEXP, SEXP sample_sizeSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type tx(txSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tcal(TcalSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tstar(TstarSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type tau(tauSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type k(kSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type lambda(lambdaSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< int >::type censor(censorSEXP);
+    Rcpp::traits::input_parameter< int >::type sample_size(sample_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mcmc_summarize_future_transactions_cpp(tx, Tcal, Tstar, tau, k, lambda, probs, censor, sample_size, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// pggg_mcmc_chain
+List pggg_mcmc_chain(SEXP state, NumericVector level_2_init, NumericVector hyper, int mcmc, int burnin, int thin, int chain_id, int trace, int threads, std::string palive_rule, bool adaptive, std::string slice_method, int slice_max_evals, bool profile, bool summarize);
+RcppExport SEXP _BTYDplus_pggg_mcmc_chain(SEXP stateSEXP, SEXP level_2_initSEXP, SEXP hyperSEXP, SEXP mcmcSEXP, SEXP burninSEXP, SEXP thinSEXP, SEXP chain_idSEXP, SEXP traceSEXP, SEXP threadsSEXP, SEXP palive_ruleSEXP, SEXP adaptiveSEXP, SEXP slice_methodSEXP, SEXP slice_max_evalsSEXP, SEXP profileSEXP, SEXP summarizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type level_2_init(level_2_initSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type hyper(hyperSEXP);
+    Rcpp::traits::input_parameter< int >::type mcmc(mcmcSEXP);
+    Rcpp::traits::input_parameter< int >::type burnin(burninSEXP);
+    Rcpp::traits::input_parameter< int >::type thin(thinSEXP);
+    Rcpp::traits::input_parameter< int >::type chain_id(chain_idSEXP);
+    Rcpp::traits::input_parameter< int >::type trace(traceSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type palive_rule(palive_ruleSEXP);
+    Rcpp::traits::input_parameter< bool >::type adaptive(adaptiveSEXP);
+    Rcpp::traits::input_parameter< std::string >::type slice_method(slice_methodSEXP);
+    Rcpp::traits::input_parameter< int >::type slice_max_evals(slice_max_evalsSEXP);
+    Rcpp::traits::input_parameter< bool >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< bool >::type summarize(summarizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(pggg_mcmc_chain(state, level_2_init, hyper, mcmc, burnin, thin, chain_id, trace, threads, palive_rule, adaptive, slice_method, slice_max_evals, profile, summarize));
+    return rcpp_result_gen;
+END_RCPP
+}
+// pggg_mcmc_chains
+List pggg_mcmc_chains(List states, NumericMatrix level_2_init, NumericVector hyper, int mcmc, int burnin, int thin, int trace, std::string palive_rule, bool adaptive, std::string slice_method, int slice_max_evals, bool profile, SEXP store, int chain_threads, bool summarize);
+RcppExport SEXP _BTYDplus_pggg_mcmc_chains(SEXP statesSEXP, SEXP level_2_initSEXP, SEXP hyperSEXP, SEXP mcmcSEXP, SEXP burninSEXP, SEXP thinSEXP, SEXP traceSEXP, SEXP palive_ruleSEXP, SEXP adaptiveSEXP, SEXP slice_methodSEXP, SEXP slice_max_evalsSEXP, SEXP profileSEXP, SEXP storeSEXP, SEXP chain_threadsSEXP, SEXP summarizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type states(statesSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type level_2_init(level_2_initSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type hyper(hyperSEXP);
+    Rcpp::traits::input_parameter< int >::type mcmc(mcmcSEXP);
+    Rcpp::traits::input_parameter< int >::type burnin(burninSEXP);
+    Rcpp::traits::input_parameter< int >::type thin(thinSEXP);
+    Rcpp::traits::input_parameter< int >::type trace(traceSEXP);
+    Rcpp::traits::input_parameter< std::string >::type palive_rule(palive_ruleSEXP);
+    Rcpp::traits::input_parameter< bool >::type adaptive(adaptiveSEXP);
+    Rcpp::traits::input_parameter< std::string >::type slice_method(slice_methodSEXP);
+    Rcpp::traits::input_parameter< int >::type slice_max_evals(slice_max_evalsSEXP);
+    Rcpp::traits::input_parameter< bool >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type chain_threads(chain_threadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type summarize(summarizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(pggg_mcmc_chains(states, level_2_init, hyper, mcmc, burnin, thin, trace, palive_rule, adaptive, slice_method, slice_max_evals, profile, store, chain_threads, summarize));
+    return rcpp_result_gen;
+END_RCPP
+}
+// abe_draw_level_1_cpp
+List abe_draw_level_1_cpp(NumericVector x, NumericVector Tcal, NumericVector z, NumericVector tau, NumericVector lambda, NumericVector mu, NumericMatrix covars, NumericMatrix beta, NumericMatrix gamma, NumericMatrix inv_gamma, int threads);
+RcppExport SEXP _BTYDplus_abe_draw_level_1_cpp(SEXP xSEXP, SEXP TcalSEXP, SEXP zSEXP, SEXP tauSEXP, SEXP lambdaSEXP, SEXP muSEXP, SEXP covarsSEXP, SEXP betaSEXP, SEXP gammaSEXP, SEXP inv_gammaSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tcal(TcalSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type z(zSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type tau(tauSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type lambda(lambdaSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type mu(muSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type covars(covarsSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type beta(betaSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type gamma(gammaSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type inv_gamma(inv_gammaSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(abe_draw_level_1_cpp(x, Tcal, z, tau, lambda, mu, covars, beta, gamma, inv_gamma, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// pnbd_mcmc_chain
+List pnbd_mcmc_chain(SEXP state, NumericVector level_2_init, NumericVector hyper, int mcmc, int burnin, int thin, bool use_data_augmentation, int chain_id, int trace, int threads, bool adaptive, std::string slice_method, int slice_max_evals, bool profile, bool summarize);
+RcppExport SEXP _BTYDplus_pnbd_mcmc_chain(SEXP stateSEXP, SEXP level_2_initSEXP, SEXP hyperSEXP, SEXP mcmcSEXP, SEXP burninSEXP, SEXP thinSEXP, SEXP use_data_augmentationSEXP, SEXP chain_idSEXP, SEXP traceSEXP, SEXP threadsSEXP, SEXP adaptiveSEXP, SEXP slice_methodSEXP, SEXP slice_max_evalsSEXP, SEXP profileSEXP, SEXP summarizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type level_2_init(level_2_initSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type hyper(hyperSEXP);
+    Rcpp::traits::input_parameter< int >::type mcmc(mcmcSEXP);
+    Rcpp::traits::input_parameter< int >::type burnin(burninSEXP);
+    Rcpp::traits::input_parameter< int >::type thin(thinSEXP);
+    Rcpp::traits::input_parameter< bool >::type use_data_augmentation(use_data_augmentationSEXP);
+    Rcpp::traits::input_parameter< int >::type chain_id(chain_idSEXP);
+    Rcpp::traits::input_parameter< int >::type trace(traceSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type adaptive(adaptiveSEXP);
+    Rcpp::traits::input_parameter< std::string >::type slice_method(slice_methodSEXP);
+    Rcpp::traits::input_parameter< int >::type slice_max_evals(slice_max_evalsSEXP);
+    Rcpp::traits::input_parameter< bool >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< bool >::type summarize(summarizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(pnbd_mcmc_chain(state, level_2_init, hyper, mcmc, burnin, thin, use_data_augmentation, chain_id, trace, threads, adaptive, slice_method, slice_max_evals, profile, summarize));
+    return rcpp_result_gen;
+END_RCPP
+}
+// pnbd_mcmc_chains
+List pnbd_mcmc_chains(List states, NumericMatrix level_2_init, NumericVector hyper, int mcmc, int burnin, int thin, bool use_data_augmentation, int trace, bool adaptive, std::string slice_method, int slice_max_evals, bool profile, SEXP store, int chain_threads, bool summarize);
+RcppExport SEXP _BTYDplus_pnbd_mcmc_chains(SEXP statesSEXP, SEXP level_2_initSEXP, SEXP hyperSEXP, SEXP mcmcSEXP, SEXP burninSEXP, SEXP thinSEXP, SEXP use_data_augmentationSEXP, SEXP traceSEXP, SEXP adaptiveSEXP, SEXP slice_methodSEXP, SEXP slice_max_evalsSEXP, SEXP profileSEXP, SEXP storeSEXP, SEXP chain_threadsSEXP, SEXP summarizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type states(statesSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type level_2_init(level_2_initSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type hyper(hyperSEXP);
+    Rcpp::traits::input_parameter< int >::type mcmc(mcmcSEXP);
+    Rcpp::traits::input_parameter< int >::type burnin(burninSEXP);
+    Rcpp::traits::input_parameter< int >::type thin(thinSEXP);
+    Rcpp::traits::input_parameter< bool >::type use_data_augmentation(use_data_augmentationSEXP);
+    Rcpp::traits::input_parameter< int >::type trace(traceSEXP);
+    Rcpp::traits::input_parameter< bool >::type adaptive(adaptiveSEXP);
+    Rcpp::traits::input_parameter< std::string >::type slice_method(slice_methodSEXP);
+    Rcpp::traits::input_parameter< int >::type slice_max_evals(slice_max_evalsSEXP);
+    Rcpp::traits::input_parameter< bool >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type chain_threads(chain_threadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type summarize(summarizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(pnbd_mcmc_chains(states, level_2_init, hyper, mcmc, burnin, thin, use_data_augmentation, trace, adaptive, slice_method, slice_max_evals, profile, store, chain_threads, summarize));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mcmc_score_pnbd_cpp
+NumericMatrix mcmc_score_pnbd_cpp(SEXP store, int lambda, int mu, NumericVector tx, NumericVector Tcal, NumericVector Tstar, int offset, int threads);
+RcppExport SEXP _BTYDplus_mcmc_score_pnbd_cpp(SEXP storeSEXP, SEXP lambdaSEXP, SEXP muSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP TstarSEXP, SEXP offsetSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< int >::type lambda(lambdaSEXP);
+    Rcpp::traits::input_parameter< int >::type mu(muSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type tx(txSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tcal(TcalSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tstar(TstarSEXP);
+    Rcpp::traits::input_parameter< int >::type offset(offsetSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mcmc_score_pnbd_cpp(store, lambda, mu, tx, Tcal, Tstar, offset, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // slice_sample_gamma_parameters
 NumericVector slice_sample_gamma_parameters(NumericVector data, NumericVector init, NumericVector hyper, double steps, double w);
 RcppExport SEXP _BTYDplus_slice_sample_gamma_parameters(SEXP dataSEXP, SEXP initSEXP, SEXP hyperSEXP, SEXP stepsSEXP, SEXP wSEXP) {
@@ -21,8 +440,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // slice_sample_ma_liu
-NumericVector slice_sample_ma_liu(String what, NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector lambda, NumericVector mu, double r, double alpha, double s, double beta);
-RcppExport SEXP _BTYDplus_slice_sample_ma_liu(SEXP whatSEXP, SEXP xSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP lambdaSEXP, SEXP muSEXP, SEXP rSEXP, SEXP alphaSEXP, SEXP sSEXP, SEXP betaSEXP) {
+NumericVector slice_sample_ma_liu(String what, NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector lambda, NumericVector mu, double r, double alpha, double s, double beta, int threads);
+RcppExport SEXP _BTYDplus_slice_sample_ma_liu(SEXP whatSEXP, SEXP xSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP lambdaSEXP, SEXP muSEXP, SEXP rSEXP, SEXP alphaSEXP, SEXP sSEXP, SEXP betaSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -36,13 +455,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type alpha(alphaSEXP);
     Rcpp::traits::input_parameter< double >::type s(sSEXP);
     Rcpp::traits::input_parameter< double >::type beta(betaSEXP);
-    rcpp_result_gen = Rcpp::wrap(slice_sample_ma_liu(what, x, tx, Tcal, lambda, mu, r, alpha, s, beta));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(slice_sample_ma_liu(what, x, tx, Tcal, lambda, mu, r, alpha, s, beta, threads));
     return rcpp_result_gen;
 END_RCPP
 }
 // pggg_palive
-NumericVector pggg_palive(NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector k, NumericVector lambda, NumericVector mu);
-RcppExport SEXP _BTYDplus_pggg_palive(SEXP xSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP kSEXP, SEXP lambdaSEXP, SEXP muSEXP) {
+NumericVector pggg_palive(NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector k, NumericVector lambda, NumericVector mu, std::string rule, int threads);
+RcppExport SEXP _BTYDplus_pggg_palive(SEXP xSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP kSEXP, SEXP lambdaSEXP, SEXP muSEXP, SEXP ruleSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -52,13 +472,27 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< NumericVector >::type k(kSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type lambda(lambdaSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type mu(muSEXP);
-    rcpp_result_gen = Rcpp::wrap(pggg_palive(x, tx, Tcal, k, lambda, mu));
+    Rcpp::traits::input_parameter< std::string >::type rule(ruleSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(pggg_palive(x, tx, Tcal, k, lambda, mu, rule, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// pggg_log_upper_gamma
+NumericVector pggg_log_upper_gamma(NumericVector x, double shape);
+RcppExport SEXP _BTYDplus_pggg_log_upper_gamma(SEXP xSEXP, SEXP shapeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< double >::type shape(shapeSEXP);
+    rcpp_result_gen = Rcpp::wrap(pggg_log_upper_gamma(x, shape));
     return rcpp_result_gen;
 END_RCPP
 }
 // pggg_slice_sample
-NumericVector pggg_slice_sample(String what, NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector litt, NumericVector k, NumericVector lambda, NumericVector mu, NumericVector tau, double t, double gamma, double r, double alpha, double s, double beta);
-RcppExport SEXP _BTYDplus_pggg_slice_sample(SEXP whatSEXP, SEXP xSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP littSEXP, SEXP kSEXP, SEXP lambdaSEXP, SEXP muSEXP, SEXP tauSEXP, SEXP tSEXP, SEXP gammaSEXP, SEXP rSEXP, SEXP alphaSEXP, SEXP sSEXP, SEXP betaSEXP) {
+NumericVector pggg_slice_sample(String what, NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector litt, NumericVector k, NumericVector lambda, NumericVector mu, NumericVector tau, double t, double gamma, double r, double alpha, double s, double beta, int threads);
+RcppExport SEXP _BTYDplus_pggg_slice_sample(SEXP whatSEXP, SEXP xSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP littSEXP, SEXP kSEXP, SEXP lambdaSEXP, SEXP muSEXP, SEXP tauSEXP, SEXP tSEXP, SEXP gammaSEXP, SEXP rSEXP, SEXP alphaSEXP, SEXP sSEXP, SEXP betaSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -77,7 +511,30 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type alpha(alphaSEXP);
     Rcpp::traits::input_parameter< double >::type s(sSEXP);
     Rcpp::traits::input_parameter< double >::type beta(betaSEXP);
-    rcpp_result_gen = Rcpp::wrap(pggg_slice_sample(what, x, tx, Tcal, litt, k, lambda, mu, tau, t, gamma, r, alpha, s, beta));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(pggg_slice_sample(what, x, tx, Tcal, litt, k, lambda, mu, tau, t, gamma, r, alpha, s, beta, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// simd_compare_cpp
+NumericMatrix simd_compare_cpp(String what, NumericVector v, NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector litt, NumericVector k, NumericVector lambda, NumericVector mu, NumericVector tau, NumericVector prior, bool avx2);
+RcppExport SEXP _BTYDplus_simd_compare_cpp(SEXP whatSEXP, SEXP vSEXP, SEXP xSEXP, SEXP txSEXP, SEXP TcalSEXP, SEXP littSEXP, SEXP kSEXP, SEXP lambdaSEXP, SEXP muSEXP, SEXP tauSEXP, SEXP priorSEXP, SEXP avx2SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< String >::type what(whatSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type v(vSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type tx(txSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type Tcal(TcalSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type litt(littSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type k(kSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type lambda(lambdaSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type mu(muSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type tau(tauSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type prior(priorSEXP);
+    Rcpp::traits::input_parameter< bool >::type avx2(avx2SEXP);
+    rcpp_result_gen = Rcpp::wrap(simd_compare_cpp(what, v, x, tx, Tcal, litt, k, lambda, mu, tau, prior, avx2));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -108,14 +565,58 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// xbgcnbd_pmf_grid_cpp
+NumericMatrix xbgcnbd_pmf_grid_cpp(NumericVector params, NumericVector t, IntegerVector x, bool dropout_at_zero, int threads);
+RcppExport SEXP _BTYDplus_xbgcnbd_pmf_grid_cpp(SEXP paramsSEXP, SEXP tSEXP, SEXP xSEXP, SEXP dropout_at_zeroSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type params(paramsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type t(tSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< bool >::type dropout_at_zero(dropout_at_zeroSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(xbgcnbd_pmf_grid_cpp(params, t, x, dropout_at_zero, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 
 static const R_CallMethodDef CallEntries[] = {
+    {"_BTYDplus_xbgcnbd_ll_cpp", (DL_FUNC) &_BTYDplus_xbgcnbd_ll_cpp, 7},
+    {"_BTYDplus_xbgcnbd_ll_grad_cpp", (DL_FUNC) &_BTYDplus_xbgcnbd_ll_grad_cpp, 8},
+    {"_BTYDplus_customer_state_create", (DL_FUNC) &_BTYDplus_customer_state_create, 1},
+    {"_BTYDplus_customer_state_set", (DL_FUNC) &_BTYDplus_customer_state_set, 3},
+    {"_BTYDplus_customer_state_get", (DL_FUNC) &_BTYDplus_customer_state_get, 2},
+    {"_BTYDplus_draw_store_create", (DL_FUNC) &_BTYDplus_draw_store_create, 3},
+    {"_BTYDplus_draw_store_single", (DL_FUNC) &_BTYDplus_draw_store_single, 1},
+    {"_BTYDplus_draw_store_open", (DL_FUNC) &_BTYDplus_draw_store_open, 2},
+    {"_BTYDplus_draw_store_close", (DL_FUNC) &_BTYDplus_draw_store_close, 1},
+    {"_BTYDplus_draw_store_is_open", (DL_FUNC) &_BTYDplus_draw_store_is_open, 1},
+    {"_BTYDplus_draw_store_dim", (DL_FUNC) &_BTYDplus_draw_store_dim, 1},
+    {"_BTYDplus_draw_store_write_chain", (DL_FUNC) &_BTYDplus_draw_store_write_chain, 3},
+    {"_BTYDplus_draw_store_matrix", (DL_FUNC) &_BTYDplus_draw_store_matrix, 4},
+    {"_BTYDplus_draw_store_mean", (DL_FUNC) &_BTYDplus_draw_store_mean, 3},
+    {"_BTYDplus_draw_store_customer", (DL_FUNC) &_BTYDplus_draw_store_customer, 3},
+    {"_BTYDplus_elog2cbs_cpp", (DL_FUNC) &_BTYDplus_elog2cbs_cpp, 8},
+    {"_BTYDplus_elog2cbs_update_cpp", (DL_FUNC) &_BTYDplus_elog2cbs_update_cpp, 14},
+    {"_BTYDplus_cbs_unique_cpp", (DL_FUNC) &_BTYDplus_cbs_unique_cpp, 1},
+    {"_BTYDplus_mcmc_draw_future_transactions_cpp", (DL_FUNC) &_BTYDplus_mcmc_draw_future_transactions_cpp, 8},
+    {"_BTYDplus_mcmc_summarize_future_transactions_cpp", (DL_FUNC) &_BTYDplus_mcmc_summarize_future_transactions_cpp, 10},
+    {"_BTYDplus_pggg_mcmc_chain", (DL_FUNC) &_BTYDplus_pggg_mcmc_chain, 15},
+    {"_BTYDplus_pggg_mcmc_chains", (DL_FUNC) &_BTYDplus_pggg_mcmc_chains, 15},
+    {"_BTYDplus_abe_draw_level_1_cpp", (DL_FUNC) &_BTYDplus_abe_draw_level_1_cpp, 11},
+    {"_BTYDplus_pnbd_mcmc_chain", (DL_FUNC) &_BTYDplus_pnbd_mcmc_chain, 15},
+    {"_BTYDplus_pnbd_mcmc_chains", (DL_FUNC) &_BTYDplus_pnbd_mcmc_chains, 15},
+    {"_BTYDplus_mcmc_score_pnbd_cpp", (DL_FUNC) &_BTYDplus_mcmc_score_pnbd_cpp, 8},
     {"_BTYDplus_slice_sample_gamma_parameters", (DL_FUNC) &_BTYDplus_slice_sample_gamma_parameters, 5},
-    {"_BTYDplus_slice_sample_ma_liu", (DL_FUNC) &_BTYDplus_slice_sample_ma_liu, 10},
-    {"_BTYDplus_pggg_palive", (DL_FUNC) &_BTYDplus_pggg_palive, 6},
-    {"_BTYDplus_pggg_slice_sample", (DL_FUNC) &_BTYDplus_pggg_slice_sample, 15},
+    {"_BTYDplus_slice_sample_ma_liu", (DL_FUNC) &_BTYDplus_slice_sample_ma_liu, 11},
+    {"_BTYDplus_pggg_palive", (DL_FUNC) &_BTYDplus_pggg_palive, 8},
+    {"_BTYDplus_pggg_log_upper_gamma", (DL_FUNC) &_BTYDplus_pggg_log_upper_gamma, 2},
+    {"_BTYDplus_pggg_slice_sample", (DL_FUNC) &_BTYDplus_pggg_slice_sample, 16},
+    {"_BTYDplus_simd_compare_cpp", (DL_FUNC) &_BTYDplus_simd_compare_cpp, 12},
     {"_BTYDplus_xbgcnbd_pmf_cpp", (DL_FUNC) &_BTYDplus_xbgcnbd_pmf_cpp, 4},
     {"_BTYDplus_xbgcnbd_exp_cpp", (DL_FUNC) &_BTYDplus_xbgcnbd_exp_cpp, 3},
+    {"_BTYDplus_xbgcnbd_pmf_grid_cpp", (DL_FUNC) &_BTYDplus_xbgcnbd_pmf_grid_cpp, 5},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,81 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <vector>
+#include "parallel.h"
+#include "bg-cnbd-k.h"
+
+using namespace Rcpp;
+
+// ********* BG/CNBD-k log-likelihood **********
+
+// Shorter inputs are recycled to the length of the longest of `x`, `tx` and
+// `Tcal`, as in xbgcnbd.LL; inputs are validated on the R side.
+
+inline int xbgcnbd_max_length(NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector litt) {
+  if (x.size() == 0 || tx.size() == 0 || Tcal.size() == 0 || litt.size() == 0)
+    ::Rf_error("x, t.x, T.cal and litt must not be empty");
+  return std::max(x.size(), std::max(tx.size(), Tcal.size()));
+}
+
+// returns the log-likelihood for each customer
+// [[Rcpp::export]]
+NumericVector xbgcnbd_ll_cpp(NumericVector params, NumericVector x, NumericVector tx,
+                             NumericVector Tcal, NumericVector litt,
+                             bool dropout_at_zero = false, int threads = 1) {
+  if (params.size() != 5) ::Rf_error("params needs to be of size 5 with (k, r, alpha, a, b)");
+  XbgcnbdLL ll(params[0], params[1], params[2], params[3], params[4], dropout_at_zero);
+  int N = xbgcnbd_max_length(x, tx, Tcal, litt);
+  int nx = x.size(), ntx = tx.size(), nTcal = Tcal.size(), nlitt = litt.size();
+  const double *px = x.begin(), *ptx = tx.begin(), *pTcal = Tcal.begin(), *plitt = litt.begin();
+  NumericVector res(N);
+  double* pres = res.begin();
+  parallel_ranges(N, threads, [&](int, int begin, int end) {
+    for (int i=begin; i<end; i++) {
+      pres[i] = ll(px[i % nx], ptx[i % ntx], pTcal[i % nTcal], plitt[i % nlitt], NULL);
+    }
+  });
+  return res;
+}
+
+// returns the summed log-likelihood, and its gradient with respect to
+// (r, alpha, a, b); the partial sums of each thread are added up in a fixed
+// order, so that results only depend on the number of threads. If `weights`
+// is not empty, the log-likelihood of each customer is weighted, e.g. by the
+// number of customers that share its unique tuple (x, t.x, T.cal, litt).
+// [[Rcpp::export]]
+List xbgcnbd_ll_grad_cpp(NumericVector params, NumericVector x, NumericVector tx,
+                         NumericVector Tcal, NumericVector litt,
+                         bool dropout_at_zero = false, int threads = 1,
+                         NumericVector weights = NumericVector()) {
+  if (params.size() != 5) ::Rf_error("params needs to be of size 5 with (k, r, alpha, a, b)");
+  XbgcnbdLL ll(params[0], params[1], params[2], params[3], params[4], dropout_at_zero);
+  int N = xbgcnbd_max_length(x, tx, Tcal, litt);
+  int nx = x.size(), ntx = tx.size(), nTcal = Tcal.size(), nlitt = litt.size();
+  const double *px = x.begin(), *ptx = tx.begin(), *pTcal = Tcal.begin(), *plitt = litt.begin();
+  if (weights.size() != 0 && weights.size() != N) ::Rf_error("weights must be of the same length as x");
+  const double* pw = weights.size() != 0 ? weights.begin() : NULL;
+  if (threads < 1) threads = 1;
+  // each thread accumulates into its own 128-byte slot, so that no two
+  // threads write to the same cache line
+  const int stride = 16;
+  std::vector<double> sums(stride * threads, 0.0);
+  parallel_ranges(N, threads, [&](int block, int begin, int end) {
+    double* sum = &sums[stride * block];
+    for (int i=begin; i<end; i++) {
+      if (pw == NULL) {
+        sum[0] += ll(px[i % nx], ptx[i % ntx], pTcal[i % nTcal], plitt[i % nlitt], sum + 1);
+      } else {
+        double grad[4] = {0, 0, 0, 0};
+        sum[0] += pw[i] * ll(px[i % nx], ptx[i % ntx], pTcal[i % nTcal], plitt[i % nlitt], grad);
+        for (int j=0; j<4; j++) sum[1 + j] += pw[i] * grad[j];
+      }
+    }
+  });
+  double loglik = 0;
+  NumericVector gradient(4);
+  for (int b=0; b<threads; b++) {
+    loglik += sums[stride * b];
+    for (int j=0; j<4; j++) gradient[j] += sums[stride * b + 1 + j];
+  }
+  return List::create(_["ll"] = loglik, _["gradient"] = gradient);
+}
@@ -0,0 +1,134 @@
+#ifndef BTYDPLUS_BG_CNBD_K_H
+#define BTYDPLUS_BG_CNBD_K_H
+
+#include <Rcpp.h>
+#include <cmath>
+#include "incomplete-gamma.h"
+
+// ********* BG/CNBD-k **********
+
+// Evaluates the (M)BG/CNBD-k probability mass function P(X(t) = x) for
+// x = 0, 1, 2, ... in turn. The NBD terms
+//   P(N(t) = i) = Gamma(r+i) / (Gamma(r) i!) * (alpha/(alpha+t))^r * (t/(alpha+t))^i
+// are walked via the recurrence
+//   term_{i+1} = term_i * (r+i)/(i+1) * t/(alpha+t),
+// which is kept on log scale to avoid underflow of the first terms, and the
+// running CMF of N(t) is carried over from one x to the next. Similarly, the
+// survival probability P1 of x-1 (or x, for the MBG variant) dropout
+// opportunities is updated incrementally. Each x thus costs k log/exp pairs,
+// instead of O(k x) lgamma calls.
+class XbgcnbdPmfWalker {
+public:
+  XbgcnbdPmfWalker(int k, double r, double alpha, double a, double b, double t, bool dropout_at_zero)
+    : k_(k), r_(r), a_(a), b_(b), t_(t), dropout_at_zero_(dropout_at_zero), x_(0), i_(0),
+      survivals_(dropout_at_zero ? 0 : -1), P1_(dropout_at_zero ? b / (a + b) : 1), cmf_(0),
+      log_term_(t > 0 ? r * log(alpha / (alpha + t)) : 0), log_p_(t > 0 ? log(t / (alpha + t)) : 0) {}
+
+  // returns P(X(t) = x) for the current x, and advances to x + 1
+  inline double next() {
+    if (t_ == 0) return 0;
+    // NBD terms i = k*x, ..., k*x+k-1
+    double P2a = 0;
+    for (int j = 0; j < k_; j++) {
+      P2a += nbd_term();
+    }
+    double P2b;
+    if (!dropout_at_zero_ && x_ == 0) {
+      P2b = 0;
+    } else {
+      P2b = a_ / (b_ + survivals_);
+      if (x_ > 0) P2b = P2b * (1 - cmf_);
+    }
+    double res = P1_ * (P2a + P2b);
+    // advance to x + 1
+    cmf_ += P2a;
+    x_++;
+    P1_ = P1_ * (b_ + survivals_ + 1) / (a_ + b_ + survivals_ + 1);
+    survivals_++;
+    return res;
+  }
+
+private:
+  // returns P(N(t) = i) for the current i, and advances to i + 1
+  inline double nbd_term() {
+    double term = exp(log_term_);
+    log_term_ += log((r_ + i_) / (i_ + 1)) + log_p_;
+    i_++;
+    return term;
+  }
+
+  int k_;
+  double r_, a_, b_, t_;
+  bool dropout_at_zero_;
+  int x_, i_;
+  double survivals_, P1_, cmf_, log_term_, log_p_;
+};
+
+// Log-likelihood of the (M)BG/CNBD-k model for a single customer, as in
+// xbgcnbd.LL in R/mbg-cnbd-k.R. Terms that only depend on the parameters are
+// computed once in the constructor. If `grad` is not NULL, the partial
+// derivatives with respect to (r, alpha, a, b) are added to grad[0..3]. The
+// evaluation only uses thread-safe special functions, and can thus run on
+// worker threads (see parallel_ranges).
+class XbgcnbdLL {
+public:
+  XbgcnbdLL(int k, double r, double alpha, double a, double b, bool dropout_at_zero)
+    : k_(k), r_(r), alpha_(alpha), a_(a), b_(b), d_(dropout_at_zero ? 1 : 0),
+      lgamma_k_(thread_safe_lgamma(k)), lgamma_r_(thread_safe_lgamma(r)), lgamma_b_(thread_safe_lgamma(b)), lgamma_ab_(thread_safe_lgamma(a+b)),
+      log_alpha_(log(alpha)), digamma_r_(thread_safe_digamma(r)), digamma_b_(thread_safe_digamma(b)),
+      digamma_ab_(thread_safe_digamma(a+b)) {}
+
+  inline double operator()(double x, double tx, double Tcal, double litt, double* grad) const {
+    double m = r_ + k_ * x;
+    double A = alpha_ + Tcal;
+    double P1 = (k_ - 1) * litt - x * lgamma_k_;
+    double P2 = thread_safe_lgamma(b_ + x + d_) - thread_safe_lgamma(a_ + b_ + x + d_) - lgamma_b_ + lgamma_ab_;
+    double P3 = thread_safe_lgamma(m) - lgamma_r_ + r_ * log_alpha_;
+    double P4 = -1 * m * log(A);
+    double S1 = 0;
+    if (d_ == 1 || x > 0) {
+      S1 = a_ / (b_ + x - 1 + d_) * pow(A / (alpha_ + tx), m);
+    }
+    // S2 = 1 + sum_j prod_{i<j} (m+i) * (Tcal-tx)^j / (j! * A^j)
+    double S2 = 1, dS2_dr = 0, dS2_dalpha = 0;
+    double c = 1, dlogc_dr = 0;
+    for (int j = 1; j < k_; j++) {
+      c = c * (m + j - 1) * (Tcal - tx) / (j * A);
+      dlogc_dr += 1 / (m + j - 1);
+      S2 += c;
+      dS2_dr += c * dlogc_dr;
+      dS2_dalpha -= c * j / A;
+    }
+    if (grad != NULL) {
+      double S = S1 + S2;
+      double log_ratio = log(A / (alpha_ + tx));
+      double a_x = a_ + b_ + x + d_;
+      // the derivatives of S1 are guarded as S1 itself, as b + x - 1 + d is
+      // zero for x == 0 without dropout at zero and b == 1
+      double dS1_dr = 0, dS1_dalpha = 0, dS1_da = 0, dS1_db = 0;
+      if (d_ == 1 || x > 0) {
+        dS1_dr = S1 * log_ratio;
+        dS1_dalpha = S1 * m * (1 / A - 1 / (alpha_ + tx));
+        dS1_da = S1 / a_;
+        dS1_db = -S1 / (b_ + x - 1 + d_);
+      }
+      grad[0] += thread_safe_digamma(m) - digamma_r_ + log_alpha_ - log(A) +
+        (dS1_dr + dS2_dr) / S;
+      grad[1] += r_ / alpha_ - m / A +
+        (dS1_dalpha + dS2_dalpha) / S;
+      double digamma_a_x = thread_safe_digamma(a_x);
+      grad[2] += digamma_ab_ - digamma_a_x + dS1_da / S;
+      grad[3] += thread_safe_digamma(b_ + x + d_) - digamma_a_x - digamma_b_ + digamma_ab_ +
+        dS1_db / S;
+    }
+    return P1 + P2 + P3 + P4 + log(S1 + S2);
+  }
+
+private:
+  int k_;
+  double r_, alpha_, a_, b_, d_;
+  double lgamma_k_, lgamma_r_, lgamma_b_, lgamma_ab_, log_alpha_;
+  double digamma_r_, digamma_b_, digamma_ab_;
+};
+
+#endif
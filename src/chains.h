@@ -0,0 +1,164 @@
+#ifndef BTYDPLUS_CHAINS_H
+#define BTYDPLUS_CHAINS_H
+
+#include <Rcpp.h>
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "parallel.h"
+#include "rng.h"
+#include "draw-store.h"
+
+// MCMC chains that run as threads of the R process
+//
+// The chains of a model are run by a single loop (e.g. pggg_chain_loop), that
+// is called either once per R call, on the main thread, or for several chains
+// at once from within run_chain_threads. In the latter case, all chains write
+// into disjoint slices of one (draw, param, customer, chain) array, see
+// draw-store.h, so that their customer-level draws need not be copied or
+// serialized. A chain only calls into R if it runs on the main thread, i.e.
+// to print its progress and to check for user interrupts; it then sets the
+// shared `stop` flag, so that the chains on the other threads stop as well.
+//
+// Instead of their draws, the chains can also keep online summaries of the
+// customer-level parameters (see ChainSummary), which need O(customers x
+// params) rather than O(draws x customers x params) memory.
+
+// where a chain writes its draws, and whether it may call into R
+struct ChainIO {
+  double* level_1;          // (draw, param, customer) slice of the chain, or NULL
+  double* level_2;          // (draw, param) slice of the chain
+  bool main_thread;
+  std::atomic<bool>* stop;  // shared between chains that run as threads, or NULL
+  // online summaries, if `level_1` is NULL: running mean and sum of squared
+  // deviations of each (customer, param), and running mean of P(alive)
+  double *mean, *m2, *palive;
+  // (draw, param, customer) slice of the chain within a single precision
+  // store, which is used instead of `level_1` if not NULL
+  float* level_1_single;
+};
+
+// stores draw `idx` of customer `i`, i.e. the values `v` of its `P`
+// customer-level parameters, either into `level_1` (or `level_1_single`), or
+// into the online summaries via Welford's algorithm; `palive` is the
+// customer's P(alive) given the current parameters
+inline void chain_store_level_1(const ChainIO& io, int nr_of_draws, int N, int P, int idx, int i,
+                                const double* v, double palive) {
+  if (io.level_1 != NULL) {
+    double* dst = io.level_1 + idx + static_cast<R_xlen_t>(nr_of_draws) * P * i;
+    for (int p=0; p<P; p++) dst[static_cast<R_xlen_t>(p) * nr_of_draws] = v[p];
+    return;
+  }
+  if (io.level_1_single != NULL) {
+    float* dst = io.level_1_single + idx + static_cast<R_xlen_t>(nr_of_draws) * P * i;
+    for (int p=0; p<P; p++) dst[static_cast<R_xlen_t>(p) * nr_of_draws] = static_cast<float>(v[p]);
+    return;
+  }
+  double n = idx + 1;
+  for (int p=0; p<P; p++) {
+    R_xlen_t j = i + static_cast<R_xlen_t>(N) * p;
+    double delta = v[p] - io.mean[j];
+    io.mean[j] += delta / n;
+    io.m2[j] += delta * (v[p] - io.mean[j]);
+  }
+  io.palive[i] += (palive - io.palive[i]) / n;
+}
+
+// the online summaries of a single chain, which are allocated on the main
+// thread; `result` returns them as list of [customer x param] matrices `mean`
+// and `m2`, `palive` and the number of draws `n`, or NULL if not `enabled`
+class ChainSummary {
+public:
+  ChainSummary(bool enabled, int N, int P)
+    : enabled_(enabled), mean_(enabled ? N : 0, P), m2_(enabled ? N : 0, P), palive_(enabled ? N : 0) {}
+
+  inline void attach(ChainIO& io) {
+    if (!enabled_) return;
+    io.level_1 = NULL;
+    io.level_1_single = NULL;
+    io.mean = mean_.begin();
+    io.m2 = m2_.begin();
+    io.palive = palive_.begin();
+  }
+
+  inline SEXP result(int n) const {
+    if (!enabled_) return R_NilValue;
+    return Rcpp::List::create(Rcpp::_["mean"] = mean_, Rcpp::_["m2"] = m2_, Rcpp::_["palive"] = palive_,
+                              Rcpp::_["n"] = n);
+  }
+
+private:
+  bool enabled_;
+  Rcpp::NumericMatrix mean_, m2_;
+  Rcpp::NumericVector palive_;
+};
+
+// metrics of a chain, that are converted into R objects on the main thread
+struct ChainResult {
+  std::array<long long, 2> evals, exhausted;
+  int stored;
+  bool interrupted;
+};
+
+// whether the caller runs on the main thread, i.e. on the thread that entered
+// parallel_ranges
+inline bool on_main_thread() {
+#ifdef _OPENMP
+  return omp_get_thread_num() == 0;
+#else
+  return true;
+#endif
+}
+
+// Runs `fn(chain, rng, main_thread)` for chains [0, chains) on up to
+// `threads` threads, each chain with its own Xoshiro256 stream. The streams
+// are split off a seed that is taken from R's RNG, with one stream per chain,
+// so that the draws of each chain are reproducible for a given seed, and do
+// not depend on the number of threads. As for parallel_ranges, `fn` must not
+// call into R unless `main_thread` is TRUE.
+template <typename Fn>
+void run_chain_threads(int chains, int threads, Fn fn) {
+  std::vector<Xoshiro256> rngs;
+  Xoshiro256 base(seed_from_r_rng());
+  for (int c = 0; c < chains; c++) {
+    rngs.push_back(base);
+    base.jump();
+  }
+  parallel_ranges(chains, std::max(1, std::min(chains, threads)), [&](int, int begin, int end) {
+    for (int c = begin; c < end; c++) fn(c, rngs[c], on_main_thread());
+  });
+}
+
+// the (draw, param, customer, chain) array that chains running as threads
+// write their customer-level draws to; either a new R array, or the writable
+// DrawStoreFile `store` of matching dimension, which holds floats if `single`
+inline void* chain_threads_store(SEXP store, Rcpp::NumericVector& values, const int* dims, bool& single) {
+  single = false;
+  if (store != R_NilValue) {
+    Rcpp::XPtr<DrawStoreFile> file(store);
+    if (file.get() == NULL) Rcpp::stop("draw store file has been closed");
+    for (int i=0; i<4; i++) {
+      if (file->dims()[i] != dims[i]) Rcpp::stop("draw store file does not match the dimension of the draws");
+    }
+    single = file->single();
+    return file->data();
+  }
+  values = Rcpp::NumericVector(static_cast<R_xlen_t>(dims[0]) * dims[1] * dims[2] * dims[3]);
+  values.attr("dim") = Rcpp::IntegerVector::create(dims[0], dims[1], dims[2], dims[3]);
+  return values.begin();
+}
+
+// points `io` to the slice of chain `c` within `data`, the array returned by
+// chain_threads_store; does nothing if `data` is NULL
+inline void chain_attach_store(ChainIO& io, void* data, bool single, const int* dims, int c) {
+  if (data == NULL) return;
+  R_xlen_t offset = static_cast<R_xlen_t>(dims[0]) * dims[1] * dims[2] * c;
+  if (single) {
+    io.level_1_single = static_cast<float*>(data) + offset;
+  } else {
+    io.level_1 = static_cast<double*>(data) + offset;
+  }
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include <Rcpp.h>
+#include "customer-state.h"
+
+using namespace Rcpp;
+
+// ********* customer state **********
+
+// [[Rcpp::export]]
+SEXP customer_state_create(DataFrame cbs) {
+  NumericVector x = cbs["x"];
+  NumericVector tx = cbs["t.x"];
+  NumericVector Tcal = cbs["T.cal"];
+  int N = x.size();
+  CustomerState* cs = new CustomerState(N);
+  std::copy(x.begin(), x.end(), cs->x.data());
+  std::copy(tx.begin(), tx.end(), cs->tx.data());
+  std::copy(Tcal.begin(), Tcal.end(), cs->Tcal.data());
+  if (cbs.containsElementNamed("litt")) {
+    NumericVector litt = cbs["litt"];
+    std::copy(litt.begin(), litt.end(), cs->litt.data());
+  } else {
+    std::fill(cs->litt.data(), cs->litt.data() + N, 0.0);
+  }
+  // customer-level parameters are set via customer_state_set
+  for (const char* name : {"k", "lambda", "mu", "tau", "z"}) {
+    AlignedBuffer* buf = cs->get(name);
+    std::fill(buf->data(), buf->data() + N, NA_REAL);
+  }
+  return XPtr<CustomerState>(cs, true);
+}
+
+// [[Rcpp::export]]
+void customer_state_set(SEXP state, String what, NumericVector values) {
+  XPtr<CustomerState> cs(state);
+  AlignedBuffer* buf = cs->get(what);
+  if (buf == NULL) Rcpp::stop("unknown customer state '%s'", what.get_cstring());
+  if (values.size() == 1) {
+    std::fill(buf->data(), buf->data() + cs->N, values[0]);
+  } else if (values.size() == cs->N) {
+    std::copy(values.begin(), values.end(), buf->data());
+  } else {
+    Rcpp::stop("values need to be of length 1 or %d", cs->N);
+  }
+}
+
+// [[Rcpp::export]]
+NumericVector customer_state_get(SEXP state, String what) {
+  XPtr<CustomerState> cs(state);
+  AlignedBuffer* buf = cs->get(what);
+  if (buf == NULL) Rcpp::stop("unknown customer state '%s'", what.get_cstring());
+  return NumericVector(buf->data(), buf->data() + cs->N);
+}
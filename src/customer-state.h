@@ -0,0 +1,70 @@
+#ifndef BTYDPLUS_CUSTOMER_STATE_H
+#define BTYDPLUS_CUSTOMER_STATE_H
+
+#include <Rcpp.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// customer state of an MCMC chain
+//
+// The sufficient statistics and the current customer-level parameters are
+// kept as a structure of arrays, with each array aligned to a cache line. The
+// state is built once per chain from the CBS, is updated in place by the
+// samplers, and is only copied into R objects at the thinning points. It is
+// exposed to R as an external pointer (see customer-state.cpp).
+
+// array of doubles, whose first element is aligned to a 64-byte cache line
+class AlignedBuffer {
+public:
+  static const std::size_t alignment = 64;
+
+  explicit AlignedBuffer(std::size_t n = 0) : n_(n), storage_(n + alignment / sizeof(double)) {
+    std::uintptr_t p = reinterpret_cast<std::uintptr_t>(storage_.data());
+    std::size_t offset = (alignment - p % alignment) % alignment;
+    ptr_ = storage_.data() + offset / sizeof(double);
+  }
+  // copying would leave ptr_ pointing into the storage of the original
+  AlignedBuffer(const AlignedBuffer&) = delete;
+  AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+  inline double* data() { return ptr_; }
+  inline const double* data() const { return ptr_; }
+  inline std::size_t size() const { return n_; }
+  inline double& operator[](std::size_t i) { return ptr_[i]; }
+  inline const double& operator[](std::size_t i) const { return ptr_[i]; }
+
+private:
+  std::size_t n_;
+  std::vector<double> storage_;
+  double* ptr_;
+};
+
+struct CustomerState {
+  int N;
+  // sufficient statistics
+  AlignedBuffer x, tx, Tcal, litt;
+  // customer-level parameters
+  AlignedBuffer k, lambda, mu, tau, z;
+
+  explicit CustomerState(int N_) : N(N_), x(N_), tx(N_), Tcal(N_), litt(N_),
+                                   k(N_), lambda(N_), mu(N_), tau(N_), z(N_) {}
+
+  // look up an array by its name, as used in the R code; returns NULL for
+  // unknown names
+  AlignedBuffer* get(const std::string& name) {
+    if (name == "x") return &x;
+    if (name == "t.x") return &tx;
+    if (name == "T.cal") return &Tcal;
+    if (name == "litt") return &litt;
+    if (name == "k") return &k;
+    if (name == "lambda") return &lambda;
+    if (name == "mu") return &mu;
+    if (name == "tau") return &tau;
+    if (name == "z") return &z;
+    return NULL;
+  }
+};
+
+#endif
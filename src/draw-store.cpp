@@ -0,0 +1,146 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include "draw-store.h"
+
+using namespace Rcpp;
+
+// ********* compact draw store **********
+
+inline void check_draw_store_args(const DrawStoreView& v, int param, int offset) {
+  if (param < 1 || param > v.nr_of_params) Rcpp::stop("param needs to be within 1 and %d", v.nr_of_params);
+  if (offset < 0 || offset >= v.nr_of_draws) Rcpp::stop("offset needs to be within 0 and %d", v.nr_of_draws - 1);
+}
+
+// copies the draws of `param` for customer `cust` within `chain`, skipping
+// the first `offset` draws, to `out` as doubles; returns the end of the copy
+inline double* copy_draws(const DrawStoreView& v, int param, int cust, int chain, int offset, double* out) {
+  int n = v.nr_of_draws - offset;
+  if (v.single) {
+    draw_store_convert(v.draws<float>(param, cust, chain) + offset, n, out);
+  } else {
+    const double* draws = v.draws<double>(param, cust, chain) + offset;
+    std::copy(draws, draws + n, out);
+  }
+  return out + n;
+}
+
+// [[Rcpp::export]]
+void draw_store_create(std::string path, IntegerVector dims, bool single = false) {
+  if (dims.size() != 4 || *std::min_element(dims.begin(), dims.end()) < 1)
+    Rcpp::stop("dims need to be 4 positive integers");
+  int32_t d[4] = {dims[0], dims[1], dims[2], dims[3]};
+  DrawStoreFile::create(path, d, single);
+}
+
+// rounds the numeric array `values` to single precision, and returns the
+// floats as integer array of the same dimension, i.e. as an in-memory single
+// precision store
+// [[Rcpp::export]]
+IntegerVector draw_store_single(NumericVector values) {
+  IntegerVector out(values.size());
+  static_assert(sizeof(float) == sizeof(int), "floats need to be of the same size as integers");
+  draw_store_convert(values.begin(), values.size(), reinterpret_cast<float*>(out.begin()));
+  out.attr("dim") = values.attr("dim");
+  return out;
+}
+
+// [[Rcpp::export]]
+SEXP draw_store_open(std::string path, bool writable = false) {
+  return XPtr<DrawStoreFile>(new DrawStoreFile(path, writable), true);
+}
+
+// unmaps the file right away, rather than once the pointer is garbage
+// collected
+// [[Rcpp::export]]
+void draw_store_close(SEXP store) {
+  if (TYPEOF(store) != EXTPTRSXP) Rcpp::stop("store needs to be a draw store file");
+  DrawStoreFile* file = static_cast<DrawStoreFile*>(R_ExternalPtrAddr(store));
+  if (file != NULL) {
+    delete file;
+    R_ClearExternalPtr(store);
+  }
+}
+
+// [[Rcpp::export]]
+bool draw_store_is_open(SEXP store) {
+  return TYPEOF(store) == EXTPTRSXP && R_ExternalPtrAddr(store) != NULL;
+}
+
+// [[Rcpp::export]]
+IntegerVector draw_store_dim(SEXP store) {
+  DrawStoreView v = draw_store_view(store);
+  return IntegerVector::create(v.nr_of_draws, v.nr_of_params, v.nr_of_cust, v.nr_of_chains);
+}
+
+// copies the (draw x param x customer) array of a single chain into the file
+// [[Rcpp::export]]
+void draw_store_write_chain(SEXP store, NumericVector values, int chain) {
+  XPtr<DrawStoreFile> file(store);
+  if (file.get() == NULL) Rcpp::stop("draw store file has been closed");
+  DrawStoreView v = file->view();
+  if (chain < 1 || chain > v.nr_of_chains) Rcpp::stop("chain needs to be within 1 and %d", v.nr_of_chains);
+  R_xlen_t n = static_cast<R_xlen_t>(v.nr_of_draws) * v.nr_of_params * v.nr_of_cust;
+  if (values.size() != n) Rcpp::stop("values need to be of length %d", n);
+  if (v.single) {
+    draw_store_convert(values.begin(), n, static_cast<float*>(file->data()) + n * (chain - 1));
+  } else {
+    std::copy(values.begin(), values.end(), static_cast<double*>(file->data()) + n * (chain - 1));
+  }
+}
+
+// returns the draws of `param` (1-based) for customers `idx` (1-based) as a
+// [draw x customer] matrix, with the draws of all chains stacked as in
+// as.matrix(mcmc.list); the first `offset` draws of each chain are skipped
+// [[Rcpp::export]]
+NumericMatrix draw_store_matrix(SEXP store, int param, IntegerVector idx, int offset = 0) {
+  DrawStoreView v = draw_store_view(store);
+  check_draw_store_args(v, param, offset);
+  int n = v.nr_of_draws - offset;
+  NumericMatrix res(n * v.nr_of_chains, idx.size());
+  double* out = res.begin();
+  for (int j=0; j<idx.size(); j++) {
+    if (idx[j] < 1 || idx[j] > v.nr_of_cust) Rcpp::stop("idx needs to be within 1 and %d", v.nr_of_cust);
+    for (int chain=0; chain<v.nr_of_chains; chain++) out = copy_draws(v, param - 1, idx[j] - 1, chain, offset, out);
+  }
+  return res;
+}
+
+// returns the posterior mean of `param` (1-based) for each customer
+// [[Rcpp::export]]
+NumericVector draw_store_mean(SEXP store, int param, int offset = 0) {
+  DrawStoreView v = draw_store_view(store);
+  check_draw_store_args(v, param, offset);
+  int n = v.nr_of_draws - offset;
+  NumericVector res(v.nr_of_cust);
+  for (int cust=0; cust<v.nr_of_cust; cust++) {
+    double sum = 0;
+    for (int chain=0; chain<v.nr_of_chains; chain++) {
+      if (v.single) {
+        const float* draws = v.draws<float>(param - 1, cust, chain) + offset;
+        for (int i=0; i<n; i++) sum += draws[i];
+      } else {
+        const double* draws = v.draws<double>(param - 1, cust, chain) + offset;
+        for (int i=0; i<n; i++) sum += draws[i];
+      }
+    }
+    res[cust] = sum / (static_cast<double>(n) * v.nr_of_chains);
+  }
+  return res;
+}
+
+// returns all draws of customer `cust` (1-based) as a (draw, param, chain)
+// array
+// [[Rcpp::export]]
+NumericVector draw_store_customer(SEXP store, int cust, int offset = 0) {
+  DrawStoreView v = draw_store_view(store);
+  check_draw_store_args(v, 1, offset);
+  if (cust < 1 || cust > v.nr_of_cust) Rcpp::stop("cust needs to be within 1 and %d", v.nr_of_cust);
+  int n = v.nr_of_draws - offset;
+  NumericVector res(static_cast<R_xlen_t>(n) * v.nr_of_params * v.nr_of_chains);
+  double* out = res.begin();
+  for (int chain=0; chain<v.nr_of_chains; chain++) {
+    for (int param=0; param<v.nr_of_params; param++) out = copy_draws(v, param, cust - 1, chain, offset, out);
+  }
+  res.attr("dim") = IntegerVector::create(n, v.nr_of_params, v.nr_of_chains);
+  return res;
+}
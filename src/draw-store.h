@@ -0,0 +1,180 @@
+#ifndef BTYDPLUS_DRAW_STORE_H
+#define BTYDPLUS_DRAW_STORE_H
+
+#include <Rcpp.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// compact storage of customer-level MCMC draws
+//
+// All draws of all chains are kept in one contiguous array with dimension
+// (draw, param, customer, chain), i.e. with the draws of a single parameter,
+// customer and chain next to each other. That is the layout of the (draw x
+// param x customer) arrays that the MCMC chains return, so that each chain is
+// copied as one block. The array is either a plain R array, or resides in a
+// memory-mapped file with a small header (see DrawStoreFile).
+//
+// The draws are stored either as doubles, or in single precision, as floats,
+// which halves the memory and I/O of the store. Since R has no single
+// precision type, in-memory single precision stores are integer arrays that
+// hold the bits of the floats. The chains always sample in double precision;
+// values are only rounded once they are stored, and are converted back to
+// doubles when they are read.
+
+// read-only view of a draw store
+struct DrawStoreView {
+  const void* data;
+  bool single;  // whether the values are floats rather than doubles
+  int nr_of_draws, nr_of_params, nr_of_cust, nr_of_chains;
+
+  // returns the draws of `param` for customer `cust` within chain `chain`;
+  // `T` needs to be float for single precision stores, and double otherwise
+  template <typename T>
+  inline const T* draws(int param, int cust, int chain) const {
+    R_xlen_t i = ((static_cast<R_xlen_t>(chain) * nr_of_cust + cust) * nr_of_params + param);
+    return static_cast<const T*>(data) + i * nr_of_draws;
+  }
+};
+
+// header of draw store files, followed by the data; the header is padded to
+// 64 bytes, so that the data is aligned for doubles. `value_size` is the size
+// of the stored values in bytes, i.e. 4 for floats and 8 for doubles.
+struct DrawStoreHeader {
+  char magic[8];
+  int32_t dims[4];
+  int32_t value_size;
+  char padding[36];
+};
+
+static const char DRAW_STORE_MAGIC[8] = {'B', 'T', 'Y', 'D', 'D', 'R', 'W', '1'};
+
+// draw store residing in a memory-mapped file; exposed to R as an external
+// pointer. Files are mapped shared, so that chains running in forked
+// processes can write their draws into disjoint regions of the same file.
+class DrawStoreFile {
+public:
+  // creates a file for draws of dimension `dims`, filled with zeros; values
+  // are stored as floats if `single`, and as doubles otherwise
+  static void create(const std::string& path, const int32_t* dims, bool single) {
+#ifdef _WIN32
+    Rcpp::stop("memory-mapped draw stores are not supported on Windows");
+#else
+    DrawStoreHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DRAW_STORE_MAGIC, sizeof(header.magic));
+    for (int i=0; i<4; i++) header.dims[i] = dims[i];
+    header.value_size = single ? sizeof(float) : sizeof(double);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) Rcpp::stop("can't create draw store file '%s'", path);
+    bool ok = ::write(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header)) &&
+      ::ftruncate(fd, sizeof(header) + data_size(dims, header.value_size)) == 0;
+    ::close(fd);
+    if (!ok) Rcpp::stop("can't write draw store file '%s'", path);
+#endif
+  }
+
+  DrawStoreFile(const std::string& path, bool writable) : map_(NULL), size_(0) {
+#ifdef _WIN32
+    Rcpp::stop("memory-mapped draw stores are not supported on Windows");
+#else
+    int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) Rcpp::stop("can't open draw store file '%s'", path);
+    struct stat st;
+    bool ok = ::fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(DrawStoreHeader));
+    if (ok) {
+      size_ = st.st_size;
+      map_ = ::mmap(NULL, size_, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+      if (map_ == MAP_FAILED) {
+        map_ = NULL;
+        ok = false;
+      }
+    }
+    ::close(fd);
+    if (!ok) Rcpp::stop("can't map draw store file '%s'", path);
+    const DrawStoreHeader* header = static_cast<const DrawStoreHeader*>(map_);
+    if (std::memcmp(header->magic, DRAW_STORE_MAGIC, sizeof(header->magic)) != 0 ||
+        (header->value_size != sizeof(float) && header->value_size != sizeof(double)) ||
+        size_ != sizeof(DrawStoreHeader) + data_size(header->dims, header->value_size)) {
+      unmap();
+      Rcpp::stop("'%s' is not a valid draw store file", path);
+    }
+#endif
+  }
+
+  ~DrawStoreFile() { unmap(); }
+
+  DrawStoreFile(const DrawStoreFile&) = delete;
+  DrawStoreFile& operator=(const DrawStoreFile&) = delete;
+
+  inline const int32_t* dims() const { return static_cast<const DrawStoreHeader*>(map_)->dims; }
+  inline bool single() const { return static_cast<const DrawStoreHeader*>(map_)->value_size == sizeof(float); }
+  // the values, i.e. floats if single(), and doubles otherwise
+  inline void* data() { return static_cast<char*>(map_) + sizeof(DrawStoreHeader); }
+
+  inline DrawStoreView view() {
+    const int32_t* d = dims();
+    DrawStoreView v = {data(), single(), d[0], d[1], d[2], d[3]};
+    return v;
+  }
+
+private:
+  static inline std::size_t data_size(const int32_t* dims, int32_t value_size) {
+    std::size_t n = static_cast<std::size_t>(value_size);
+    for (int i=0; i<4; i++) n *= static_cast<std::size_t>(dims[i]);
+    return n;
+  }
+
+  void unmap() {
+#ifndef _WIN32
+    if (map_ != NULL) ::munmap(map_, size_);
+#endif
+    map_ = NULL;
+  }
+
+  void* map_;
+  std::size_t size_;
+};
+
+// returns a view of `store`, which is either an array of dimension (draw,
+// param, customer, chain), i.e. a numeric array, or an integer array that
+// holds floats, or an external pointer to a DrawStoreFile
+inline DrawStoreView draw_store_view(SEXP store) {
+  if (TYPEOF(store) == EXTPTRSXP) {
+    Rcpp::XPtr<DrawStoreFile> file(store);
+    if (file.get() == NULL) Rcpp::stop("draw store file has been closed");
+    return file->view();
+  }
+  if (TYPEOF(store) != REALSXP && TYPEOF(store) != INTSXP) Rcpp::stop("draw store needs to be a numeric array");
+  bool single = TYPEOF(store) == INTSXP;
+  Rcpp::IntegerVector dims;
+  const void* data;
+  if (single) {
+    Rcpp::IntegerVector values(store);
+    dims = values.attr("dim");
+    data = values.begin();
+  } else {
+    Rcpp::NumericVector values(store);
+    dims = values.attr("dim");
+    data = values.begin();
+  }
+  if (dims.size() != 4) Rcpp::stop("draw store needs to be an array of dimension (draw, param, customer, chain)");
+  DrawStoreView v = {data, single, dims[0], dims[1], dims[2], dims[3]};
+  return v;
+}
+
+// converts `n` values from `src` to `dst`, e.g. when storing doubles in a
+// single precision store
+template <typename From, typename To>
+inline void draw_store_convert(const From* src, R_xlen_t n, To* dst) {
+  for (R_xlen_t i=0; i<n; i++) dst[i] = static_cast<To>(src[i]);
+}
+
+#endif
@@ -0,0 +1,241 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace Rcpp;
+
+// ********* elog2cbs **********
+
+// equality of customer IDs in rows i and j; strings are compared by their
+// cached CHARSXP, and factors by their codes
+inline bool same_cust(SEXP cust, R_xlen_t i, R_xlen_t j) {
+  switch (TYPEOF(cust)) {
+  case INTSXP:
+  case LGLSXP:
+    return INTEGER(cust)[i] == INTEGER(cust)[j];
+  case REALSXP: {
+    double a = REAL(cust)[i], b = REAL(cust)[j];
+    return a == b || (ISNAN(a) && ISNAN(b));
+  }
+  case STRSXP:
+    return STRING_ELT(cust, i) == STRING_ELT(cust, j);
+  default:
+    Rcpp::stop("`cust` field must be an integer, numeric, character or factor vector");
+  }
+}
+
+// running summary statistics of a customer's calibration period; events
+// need to be added in chronological order, with `t` being the time since the
+// first transaction. Events at the time of the last transaction are merged
+// into it. Starting from the statistics of a previous CBS, further events can
+// be added, with results identical to those of a full sweep.
+struct CbsAccumulator {
+  double x, tx, litt, sales, sales_x;
+
+  CbsAccumulator() : x(-1), tx(0), litt(0), sales(0), sales_x(0) {}
+  CbsAccumulator(double x_, double tx_, double litt_, double sales_, double sales_x_)
+    : x(x_), tx(tx_), litt(litt_), sales(sales_), sales_x(sales_x_) {}
+
+  inline void add(double t, double s) {
+    if (x < 0 || t > tx) {
+      // new transaction
+      if (x >= 0) litt += log(t - tx);
+      x++;
+      tx = t;
+    } else if (t < tx) {
+      Rcpp::stop("events need to be added in chronological order");
+    }
+    sales += s;
+    if (x > 0) sales_x += s;
+  }
+};
+
+// Builds the CBS in a single sweep over the event log, which is walked in
+// the order `ord` (1-based), i.e. sorted by customer and date; the order is
+// determined in R with a radix sort. `date` is in days for Date, and in
+// seconds for POSIXct; `mult` converts it to seconds, and `unit` is the
+// length of the time unit in seconds, so that times match those of difftime.
+// `Tcal` and `Ttot` are in seconds. Events with identical customer and date
+// are merged to a single transaction. If `sales` is empty, each transaction
+// counts as one. Customers without any calibration transaction are dropped.
+// Events are merged by their time `t` since the first transaction, which is
+// computed exactly as in elog2cbs_update_cpp.
+// Returns the first row (1-based) of each customer, along with the summary
+// statistics; memory requirements are O(customers) on top of the inputs.
+// [[Rcpp::export]]
+List elog2cbs_cpp(SEXP cust, NumericVector date, NumericVector sales, IntegerVector ord,
+                  double mult, double unit, double Tcal, double Ttot) {
+  R_xlen_t n = ord.size();
+  bool has_sales = sales.size() > 0;
+  std::vector<int> idx;
+  std::vector<double> x, tx, litt, sales_cal, sales_x, T_cal, T_star, x_star, sales_star;
+  R_xlen_t begin = 0;
+  while (begin < n) {
+    R_xlen_t i0 = ord[begin] - 1;
+    R_xlen_t end = begin + 1;
+    while (end < n && same_cust(cust, ord[end] - 1, i0)) end++;
+    double first = date[i0] * mult;
+    if (first <= Tcal) {
+      CbsAccumulator cal;
+      double cx_star = 0, csales_star = 0, t_last = R_NegInf;
+      for (R_xlen_t j = begin; j < end; j++) {
+        R_xlen_t i = ord[j] - 1;
+        double s = has_sales ? sales[i] : 1;
+        double secs = date[i] * mult;
+        if (secs > Ttot) break;
+        double t = (secs - first) / unit;
+        if (secs <= Tcal) {
+          cal.add(t, s);
+        } else {
+          if (t > t_last) cx_star++;
+          csales_star += s;
+        }
+        t_last = t;
+      }
+      idx.push_back(static_cast<int>(i0 + 1));
+      x.push_back(cal.x);
+      tx.push_back(cal.tx);
+      litt.push_back(cal.litt);
+      sales_cal.push_back(cal.sales);
+      sales_x.push_back(cal.sales_x);
+      T_cal.push_back((Tcal - first) / unit);
+      T_star.push_back((Ttot - first) / unit - T_cal.back());
+      x_star.push_back(cx_star);
+      sales_star.push_back(csales_star);
+    }
+    begin = end;
+  }
+  return List::create(_["idx"] = idx, _["x"] = x, _["t.x"] = tx, _["litt"] = litt,
+                      _["sales"] = sales_cal, _["sales.x"] = sales_x, _["T.cal"] = T_cal,
+                      _["T.star"] = T_star, _["x.star"] = x_star, _["sales.star"] = sales_star);
+}
+
+// Updates the calibration period statistics `x`, `t.x`, `litt`, `sales` and
+// `sales.x` of a previous CBS with the events of `date` (see elog2cbs_cpp),
+// which are walked in the order `ord`. `pos` (1-based) is the row of each
+// event's customer within the CBS, or NA for new customers; `first` are the
+// dates of the customers' first transactions, in the units of `date`.
+// Events after `Tcal` are ignored, and events before a customer's last
+// transaction are rejected. Returns the updated statistics of the CBS
+// customers, including `T.cal`, as `cbs`, and the statistics of new customers
+// as `new`, in the format of elog2cbs_cpp.
+// [[Rcpp::export]]
+List elog2cbs_update_cpp(SEXP cust, NumericVector date, NumericVector sales, IntegerVector ord,
+                         IntegerVector pos, double mult, double unit, double Tcal,
+                         NumericVector first, NumericVector cbs_x, NumericVector cbs_tx,
+                         NumericVector cbs_litt, NumericVector cbs_sales, NumericVector cbs_sales_x) {
+  R_xlen_t n = ord.size();
+  int N = first.size();
+  bool has_sales = sales.size() > 0;
+  if (cbs_x.size() != N || cbs_tx.size() != N || cbs_litt.size() != N ||
+      (has_sales && (cbs_sales.size() != N || cbs_sales_x.size() != N)))
+    Rcpp::stop("CBS columns need to be of length %d", N);
+  NumericVector x = clone(cbs_x), tx = clone(cbs_tx), litt = clone(cbs_litt), T_cal(N);
+  NumericVector sales_cal = clone(cbs_sales), sales_x = clone(cbs_sales_x);
+  std::vector<int> idx;
+  std::vector<double> new_x, new_tx, new_litt, new_sales, new_sales_x, new_T_cal;
+  R_xlen_t begin = 0;
+  while (begin < n) {
+    R_xlen_t i0 = ord[begin] - 1;
+    R_xlen_t end = begin + 1;
+    while (end < n && same_cust(cust, ord[end] - 1, i0)) end++;
+    int p = pos[i0];
+    bool is_new = p == NA_INTEGER;
+    double first_secs = (is_new ? date[i0] : first[p - 1]) * mult;
+    CbsAccumulator cal;
+    if (!is_new) cal = CbsAccumulator(x[p - 1], tx[p - 1], litt[p - 1],
+                                      has_sales ? sales_cal[p - 1] : 0, has_sales ? sales_x[p - 1] : 0);
+    for (R_xlen_t j = begin; j < end; j++) {
+      R_xlen_t i = ord[j] - 1;
+      double secs = date[i] * mult;
+      if (secs > Tcal) break;
+      if (secs < first_secs) Rcpp::stop("events need to be added in chronological order");
+      cal.add((secs - first_secs) / unit, has_sales ? sales[i] : 1);
+    }
+    if (!is_new) {
+      x[p - 1] = cal.x;
+      tx[p - 1] = cal.tx;
+      litt[p - 1] = cal.litt;
+      if (has_sales) {
+        sales_cal[p - 1] = cal.sales;
+        sales_x[p - 1] = cal.sales_x;
+      }
+    } else if (cal.x >= 0) {
+      idx.push_back(static_cast<int>(i0 + 1));
+      new_x.push_back(cal.x);
+      new_tx.push_back(cal.tx);
+      new_litt.push_back(cal.litt);
+      new_sales.push_back(cal.sales);
+      new_sales_x.push_back(cal.sales_x);
+      new_T_cal.push_back((Tcal - first_secs) / unit);
+    }
+    begin = end;
+  }
+  for (int k=0; k<N; k++) T_cal[k] = (Tcal - first[k] * mult) / unit;
+  return List::create(
+    _["cbs"] = List::create(_["x"] = x, _["t.x"] = tx, _["litt"] = litt,
+                            _["sales"] = sales_cal, _["sales.x"] = sales_x, _["T.cal"] = T_cal),
+    _["new"] = List::create(_["idx"] = idx, _["x"] = new_x, _["t.x"] = new_tx, _["litt"] = new_litt,
+                            _["sales"] = new_sales, _["sales.x"] = new_sales_x, _["T.cal"] = new_T_cal));
+}
+
+// ********* unique tuples of sufficient statistics **********
+
+// Compresses the customers to the unique tuples of the numeric columns
+// `cols`, e.g. (x, t.x, T.cal, litt), which all need to be of the same
+// length. Returns `first`, the (1-based) index of the first customer of each
+// tuple, `weight`, the number of customers of each tuple, and `idx`, the
+// (1-based) tuple of each customer; tuples are numbered in the order of their
+// first customer. Values are compared by their bits, so that tuples are only
+// merged if they are exactly identical, also for NA.
+// [[Rcpp::export]]
+List cbs_unique_cpp(List cols) {
+  int P = cols.size();
+  if (P == 0) Rcpp::stop("cols must not be empty");
+  std::vector<const uint64_t*> pcols(P);
+  std::vector<NumericVector> vals(P);
+  int N = 0;
+  for (int p=0; p<P; p++) {
+    vals[p] = cols[p];
+    if (p == 0) N = vals[p].size();
+    if (vals[p].size() != N) Rcpp::stop("cols must be of the same length");
+    pcols[p] = reinterpret_cast<const uint64_t*>(vals[p].begin());
+  }
+  // sort the customers lexicographically by their tuple, and ties by their
+  // index, so that the first customer of each tuple comes first
+  std::vector<int> ord(N);
+  for (int i=0; i<N; i++) ord[i] = i;
+  auto less = [&](int i, int j) {
+    for (int p=0; p<P; p++) {
+      if (pcols[p][i] != pcols[p][j]) return pcols[p][i] < pcols[p][j];
+    }
+    return i < j;
+  };
+  auto same = [&](int i, int j) {
+    for (int p=0; p<P; p++) {
+      if (pcols[p][i] != pcols[p][j]) return false;
+    }
+    return true;
+  };
+  std::sort(ord.begin(), ord.end(), less);
+  // the first customer of the tuple of each customer
+  std::vector<int> head(N);
+  for (int k=0; k<N; k++) {
+    head[ord[k]] = (k > 0 && same(ord[k - 1], ord[k])) ? head[ord[k - 1]] : ord[k];
+  }
+  IntegerVector idx(N);
+  std::vector<int> first, weight;
+  for (int i=0; i<N; i++) {
+    if (head[i] == i) {
+      first.push_back(i + 1);
+      weight.push_back(0);
+      idx[i] = first.size();
+    } else {
+      idx[i] = idx[head[i]];
+    }
+    weight[idx[i] - 1]++;
+  }
+  return List::create(_["first"] = wrap(first), _["weight"] = wrap(weight), _["idx"] = idx);
+}
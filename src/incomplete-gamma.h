@@ -0,0 +1,182 @@
+#ifndef BTYDPLUS_INCOMPLETE_GAMMA_H
+#define BTYDPLUS_INCOMPLETE_GAMMA_H
+
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// number of evaluations of LogUpperGamma on the calling thread that fell back
+// to Rf_pgamma, for the sampler instrumentation (see profile.h); the counter is
+// per thread, so that chains that run as threads (see chains.h) only count
+// their own fallbacks, and parallel_ranges adds the fallbacks of its workers
+// to the thread that called it
+inline long long& log_upper_gamma_fallbacks() {
+  static thread_local long long n = 0;
+  return n;
+}
+
+// whether the caller runs within a parallel region of more than one thread,
+// i.e. on a worker thread of parallel_ranges, or as a chain that runs as a
+// thread (see chains.h), where R must not be called
+inline bool in_worker_thread() {
+#ifdef _OPENMP
+  return omp_in_parallel();
+#else
+  return false;
+#endif
+}
+
+// lgamma that can be called on worker threads: glibc's lgamma writes the
+// sign of Gamma(x) to the global `signgam`, while lgamma_r returns it instead;
+// other C libraries either have no lgamma_r, or a thread-safe lgamma
+inline double thread_safe_lgamma(double x) {
+#ifdef __GLIBC__
+  int sign;
+  return ::lgamma_r(x, &sign);
+#else
+  return std::lgamma(x);
+#endif
+}
+
+// digamma that can be called on worker threads, unlike nmath's Rf_digamma,
+// which may signal warnings via R; the recurrence psi(x) = psi(x + 1) - 1/x
+// shifts x to at least 10, where the asymptotic expansion is accurate to
+// about 1e-15, and reflection handles x < 0
+inline double thread_safe_digamma(double x) {
+  if (std::isnan(x) || (x <= 0 && x == std::floor(x))) return std::numeric_limits<double>::quiet_NaN();
+  if (x < 0) return thread_safe_digamma(1 - x) - M_PI / std::tan(M_PI * x);
+  double res = 0;
+  for (; x < 10; x += 1) res -= 1 / x;
+  double f = 1 / (x * x);
+  return res + std::log(x) - 0.5 / x -
+    f * (1.0/12 - f * (1.0/120 - f * (1.0/252 - f * (1.0/240 - f * (1.0/132 - f * (691.0/32760))))));
+}
+
+// log of the regularized upper incomplete gamma function Q(a, x), i.e. of
+// pgamma(x, a, lower.tail = FALSE, log.p = TRUE), for a fixed shape `a`
+//
+// The Pareto/GGG kernels evaluate Q many times for the same shape k, and only
+// varying scale: at the quadrature nodes of P(alive), and within the slice
+// samplers for lambda and tau. lgamma(a) is thus computed once, on
+// construction, and is also available to the callers' own log-densities. Each
+// evaluation then sums a power series for x < a + 1, and a continued fraction
+// (modified Lentz) otherwise, see Numerical Recipes, section 6.2. Both
+// converge within a few hundred iterations for the shapes of the samplers,
+// i.e. k in [0.1, 1000]; otherwise this falls back to nmath's pgamma. The
+// relative error is below 1e-12, and is dominated by the cancellation in
+// a log(x) - x - lgamma(a) for large shapes.
+//
+// On worker threads (see in_worker_thread) R, and thus nmath, which may
+// signal warnings via R, must not be called. There, the fallback instead
+// continues the series resp. the continued fraction for up to 1e6 iterations,
+// which suffices for shapes up to about 1e9, and throws a std::runtime_error
+// otherwise; see parallel_ranges.
+class LogUpperGamma {
+public:
+  explicit LogUpperGamma(double a = 1) : a_(a), lgamma_a_(thread_safe_lgamma(a)), log_a_(log(a)) {}
+
+  inline double shape() const { return a_; }
+  inline double lgamma_shape() const { return lgamma_a_; }
+
+  inline double operator()(double x) const {
+    if (std::isnan(x)) return x;
+    if (!(x > 0)) return 0;
+    if (x == INFINITY) return -INFINITY;
+    double out;
+    if (x < a_ + 1 ? series(x, 2000, out) : continued_fraction(x, 2000, out)) return out;
+    log_upper_gamma_fallbacks()++;
+    if (!in_worker_thread()) return ::Rf_pgamma(x, a_, 1, 0, 1);
+    // the series also fails if P(a, x) rounds to 1, in which case the
+    // continued fraction still yields Q(a, x)
+    const int max_iter = 1000000;
+    if (x < a_ + 1 && series(x, max_iter, out)) return out;
+    if (continued_fraction(x, max_iter, out)) return out;
+    throw std::runtime_error("upper incomplete gamma function did not converge");
+  }
+
+  // the `x >= lower` with log Q(a, x) = `log_q`, for log Q(a, lower) >=
+  // log_q, i.e. the quantile of the upper tail; the root is bracketed by
+  // doubling, and then found by Newton steps on log(-log Q) over log x, which
+  // is close to linear both for x -> 0, where -log Q ~ x^a / Gamma(a+1), and
+  // for x -> Inf, where -log Q ~ x; steps that leave the bracket fall back to
+  // bisection. Plain doubles only, so that this can be evaluated on worker
+  // threads.
+  inline double quantile(double log_q, double lower = 0) const {
+    const double eps = std::numeric_limits<double>::epsilon();
+    if (!(log_q < 0)) return lower;
+    if (log_q == -INFINITY) return INFINITY;
+    double lo = lower, hi = lower + std::max(1.0, a_);
+    while ((*this)(hi) > log_q) {
+      lo = hi;
+      hi = lower + 2 * (hi - lower);
+    }
+    double x = 0.5 * (lo + hi);
+    for (int iter = 0; iter < 200; iter++) {
+      double log_q_x = (*this)(x);
+      double f = log_q_x - log_q;
+      if (f == 0) return x;
+      if (f > 0) lo = x; else hi = x;
+      if (hi - lo <= 4 * eps * hi) return x;
+      // d log(-log Q) / d log x = x * (d/dx log Q) / log Q, with
+      // d/dx log Q(a, x) = -x^(a-1) exp(-x) / (Gamma(a) Q(a, x))
+      double slope = -exp(a_ * log(x) - x - lgamma_a_ - log_q_x) / log_q_x;
+      double next = x * exp(-(log(-log_q_x) - log(-log_q)) / slope);
+      if (!(next > lo && next < hi)) next = 0.5 * (lo + hi);
+      if (fabs(next - x) <= 4 * eps * x) return next;
+      x = next;
+    }
+    return x;
+  }
+
+private:
+  double a_, lgamma_a_, log_a_;
+
+  // P(a, x) = exp(log_prefix) / a * sum_n x^n / ((a+1) ... (a+n))
+  inline bool series(double x, int max_iter, double& out) const {
+    const double eps = std::numeric_limits<double>::epsilon();
+    double log_prefix = a_ * log(x) - x - lgamma_a_;
+    double term = 1, sum = 1;
+    for (int n = 1; n <= max_iter; n++) {
+      term *= x / (a_ + n);
+      sum += term;
+      if (term < sum * eps) {
+        double p = exp(log_prefix - log_a_ + log(sum));
+        if (!(p < 1)) return false;
+        out = log1p(-p);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Q(a, x) = exp(log_prefix) / (x+1-a - 1*(1-a) / (x+3-a - 2*(2-a) / (x+5-a - ...)))
+  inline bool continued_fraction(double x, int max_iter, double& out) const {
+    const double eps = std::numeric_limits<double>::epsilon(), tiny = 1e-300;
+    double log_prefix = a_ * log(x) - x - lgamma_a_;
+    double b = x + 1 - a_, c = 1 / tiny, d = 1 / b, h = d;
+    for (int n = 1; n <= max_iter; n++) {
+      double an = -n * (n - a_);
+      b += 2;
+      d = an * d + b;
+      if (fabs(d) < tiny) d = tiny;
+      c = b + an / c;
+      if (fabs(c) < tiny) c = tiny;
+      d = 1 / d;
+      double delta = d * c;
+      h *= delta;
+      if (fabs(delta - 1) < eps) {
+        out = log_prefix + log(h);
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "rng.h"
+#include "parallel.h"
+#include "incomplete-gamma.h"
+
+using namespace Rcpp;
+
+// ********* future transactions **********
+
+// draw of a gamma distribution, that is left-truncated at `lower`, by
+// inversion of its upper tail; with R's RNG via nmath's pgamma and qgamma, and
+// otherwise via LogUpperGamma, as nmath must not be called on worker threads.
+// Draws differ from those of the former R implementation for a given seed,
+// as it inverted the lower tail, i.e. used the mirrored uniform, and drew the
+// intertransaction times in over-sized blocks rather than one at a time.
+inline double draw_truncated_gamma(double lower, double shape, double scale, RRng& rng) {
+  double upper = ::Rf_pgamma(lower, shape, scale, 0, 0);
+  return ::Rf_qgamma(rng.unif_rand() * upper, shape, scale, 0, 0);
+}
+
+template <typename Rng>
+inline double draw_truncated_gamma(double lower, double shape, double scale, Rng& rng) {
+  LogUpperGamma log_q(shape);
+  double y = lower / scale;
+  return scale * log_q.quantile(log(rng.unif_rand()) + log_q(y), y);
+}
+
+// Number of transactions of a renewal process with Erlang-k / gamma
+// distributed intertransaction times within (Tcal, min(Tcal + Tstar, tau)],
+// given the last transaction at tx. The first intertransaction time is drawn
+// left-truncated at Tcal - tx via the upper tail of the gamma distribution,
+// and then further intertransaction times are accumulated one at a time.
+template <typename Rng>
+inline double draw_future_transactions(double tx, double Tcal, double Tstar, double tau,
+                                       double k, double lambda, Rng& rng) {
+  if (tau <= Tcal) return 0;  // churned
+  double minT = std::min(Tcal + Tstar - tx, tau - tx);
+  double scale = 1 / (k * lambda);
+  if (!(scale > 0) || !std::isfinite(scale)) throw std::runtime_error("invalid intertransaction time distribution");
+  double sum = draw_truncated_gamma(Tcal - tx, k, scale, rng);
+  double x = 0;
+  while (sum < minT) {
+    x++;
+    if (x > 1e9) throw std::runtime_error("too many future transactions sampled");
+    sum += rng.rgamma(k, scale);
+  }
+  return x;
+}
+
+// draws `n` future transactions for customer `cust` into `out`; if
+// `sample_size` is positive, the parameter draws are resampled with
+// replacement; see mcmc_draw_future_transactions_cpp
+template <typename Rng>
+inline void draw_future_transactions_customer(int cust, Rng& rng, int nr_of_draws, int sample_size,
+                                              const double* tx, const double* Tcal, const double* Tstar,
+                                              const double* tau, const double* k, const double* lambda,
+                                              double* out) {
+  int n = (sample_size > 0) ? sample_size : nr_of_draws;
+  R_xlen_t offset = static_cast<R_xlen_t>(nr_of_draws) * cust;
+  for (int draw=0; draw<n; draw++) {
+    R_xlen_t idx = offset + ((sample_size > 0) ? static_cast<int>(rng.unif_rand() * nr_of_draws) : draw);
+    double k_ = (k != NULL) ? k[idx] : 1;
+    out[draw] = draw_future_transactions(tx[cust], Tcal[cust], Tstar[cust], tau[idx], k_, lambda[idx], rng);
+  }
+}
+
+// draws for customers [begin, end)
+template <typename Rng>
+void draw_future_transactions_range(int begin, int end, Rng& rng, int nr_of_draws, int sample_size,
+                                    const double* tx, const double* Tcal, const double* Tstar,
+                                    const double* tau, const double* k, const double* lambda,
+                                    double* x_stars) {
+  int n = (sample_size > 0) ? sample_size : nr_of_draws;
+  for (int cust=begin; cust<end; cust++) {
+    draw_future_transactions_customer(cust, rng, nr_of_draws, sample_size, tx, Tcal, Tstar,
+                                      tau, k, lambda, x_stars + static_cast<R_xlen_t>(n) * cust);
+  }
+}
+
+inline void check_future_transactions_args(NumericVector tx, NumericVector Tcal, NumericVector Tstar,
+                                           NumericMatrix tau, NumericMatrix k, NumericMatrix lambda) {
+  int N = tau.ncol();
+  int nr_of_draws = tau.nrow();
+  if (tx.size() != N || Tcal.size() != N || Tstar.size() != N)
+    Rcpp::stop("tx, Tcal and Tstar need to be of length %d", N);
+  if (lambda.nrow() != nr_of_draws || lambda.ncol() != N)
+    Rcpp::stop("tau and lambda need to be of the same dimension");
+  if (k.ncol() > 0 && (k.nrow() != nr_of_draws || k.ncol() != N))
+    Rcpp::stop("tau and k need to be of the same dimension");
+}
+
+// Simulates the number of transactions in the holdout period for each
+// customer-level parameter draw. `tau`, `k` and `lambda` are matrices of
+// dimension (draws, customers); `k` may have no columns, for models without
+// regularity (k = 1). If `sample_size` is positive, that many draws are
+// resampled with replacement for each customer. Returns a matrix of dimension
+// (draws, customers). With threads = 1 R's RNG is used, otherwise each
+// customer gets its own stream (see parallel_streams in parallel.h).
+// [[Rcpp::export]]
+NumericMatrix mcmc_draw_future_transactions_cpp(NumericVector tx, NumericVector Tcal, NumericVector Tstar,
+                                                NumericMatrix tau, NumericMatrix k, NumericMatrix lambda,
+                                                int sample_size = 0, int threads = 1) {
+  check_future_transactions_args(tx, Tcal, Tstar, tau, k, lambda);
+  int N = tau.ncol();
+  int nr_of_draws = tau.nrow();
+  bool has_k = k.ncol() > 0;
+  NumericMatrix x_stars((sample_size > 0) ? sample_size : nr_of_draws, N);
+  const double *ptx = tx.begin(), *pTcal = Tcal.begin(), *pTstar = Tstar.begin();
+  const double *ptau = tau.begin(), *pk = has_k ? k.begin() : NULL, *plambda = lambda.begin();
+  double* px_stars = x_stars.begin();
+  if (threads <= 1) {
+    RRng rrng;
+    try {
+      draw_future_transactions_range(0, N, rrng, nr_of_draws, sample_size,
+                                     ptx, pTcal, pTstar, ptau, pk, plambda, px_stars);
+    } catch (std::exception& e) {
+      Rcpp::stop(e.what());
+    }
+  } else {
+    parallel_streams(N, threads, 1, [&](CustomerStreams& streams, int begin, int end) {
+      for (int cust=begin; cust<end; cust++)
+        draw_future_transactions_range(cust, cust+1, streams.at(cust), nr_of_draws, sample_size,
+                                       ptx, pTcal, pTstar, ptau, pk, plambda, px_stars);
+    });
+  }
+  return x_stars;
+}
+
+// ********* summaries of future transactions **********
+
+// Reduces the future transaction draws of a single customer, which are
+// sorted in place, to their mean, P(active), the quantiles `probs` (as
+// quantile(type = 7) in R) and, unless censor < 0, the shares of draws with
+// 0, 1, ..., censor-1 and censor+ transactions. Results are written to
+// column `cust` of the (customer x statistic) matrix `out`.
+inline void summarize_future_transactions(double* draws, int n, const double* probs, int nr_of_probs,
+                                          int censor, int cust, int N, double* out) {
+  double sum = 0, active = 0;
+  for (int i=0; i<n; i++) {
+    sum += draws[i];
+    if (draws[i] > 0) active++;
+  }
+  R_xlen_t col = 0;
+  out[cust + N * col++] = sum / n;
+  out[cust + N * col++] = active / n;
+  if (nr_of_probs > 0) {
+    std::sort(draws, draws + n);
+    for (int j=0; j<nr_of_probs; j++) {
+      double h = (n - 1) * probs[j];
+      int lo = static_cast<int>(std::floor(h));
+      int hi = std::min(lo + 1, n - 1);
+      out[cust + N * col++] = draws[lo] + (h - lo) * (draws[hi] - draws[lo]);
+    }
+  }
+  if (censor >= 0) {
+    double* hist = out + cust + N * col;
+    for (int j=0; j<=censor; j++) hist[static_cast<R_xlen_t>(N) * j] = 0;
+    for (int i=0; i<n; i++) {
+      int bin = (draws[i] < censor) ? static_cast<int>(draws[i]) : censor;
+      hist[static_cast<R_xlen_t>(N) * bin] += 1.0 / n;
+    }
+  }
+}
+
+// Same simulation as mcmc_draw_future_transactions_cpp, but each customer's
+// draws are reduced to summary statistics right away, so that only a buffer of
+// one customer's draws per thread is needed. Returns a (customer x statistic)
+// matrix with columns mean, P(active), the quantiles `probs`, and, if
+// `censor` is not negative, the histogram of the draws over 0, ..., censor+.
+// With threads = 1 R's RNG is consumed just as by
+// mcmc_draw_future_transactions_cpp.
+// [[Rcpp::export]]
+NumericMatrix mcmc_summarize_future_transactions_cpp(NumericVector tx, NumericVector Tcal, NumericVector Tstar,
+                                                     NumericMatrix tau, NumericMatrix k, NumericMatrix lambda,
+                                                     NumericVector probs, int censor = -1,
+                                                     int sample_size = 0, int threads = 1) {
+  check_future_transactions_args(tx, Tcal, Tstar, tau, k, lambda);
+  int N = tau.ncol();
+  int nr_of_draws = tau.nrow();
+  int n = (sample_size > 0) ? sample_size : nr_of_draws;
+  if (n < 1) Rcpp::stop("need at least one draw");
+  int nr_of_probs = probs.size();
+  for (int j=0; j<nr_of_probs; j++) {
+    if (!(probs[j] >= 0 && probs[j] <= 1)) Rcpp::stop("probs need to be within [0, 1]");
+  }
+  NumericMatrix res(N, 2 + nr_of_probs + ((censor >= 0) ? censor + 1 : 0));
+  const double *ptx = tx.begin(), *pTcal = Tcal.begin(), *pTstar = Tstar.begin();
+  const double *ptau = tau.begin(), *pk = (k.ncol() > 0) ? k.begin() : NULL, *plambda = lambda.begin();
+  const double *pprobs = probs.begin();
+  double* pres = res.begin();
+  if (threads <= 1) {
+    RRng rrng;
+    std::vector<double> buffer(n);
+    try {
+      for (int cust=0; cust<N; cust++) {
+        draw_future_transactions_customer(cust, rrng, nr_of_draws, sample_size, ptx, pTcal, pTstar,
+                                          ptau, pk, plambda, &buffer[0]);
+        summarize_future_transactions(&buffer[0], n, pprobs, nr_of_probs, censor, cust, N, pres);
+      }
+    } catch (std::exception& e) {
+      Rcpp::stop(e.what());
+    }
+  } else {
+    parallel_streams(N, threads, 1, [&](CustomerStreams& streams, int begin, int end) {
+      std::vector<double> buffer(n);
+      for (int cust=begin; cust<end; cust++) {
+        draw_future_transactions_customer(cust, streams.at(cust), nr_of_draws, sample_size, ptx, pTcal, pTstar,
+                                          ptau, pk, plambda, &buffer[0]);
+        summarize_future_transactions(&buffer[0], n, pprobs, nr_of_probs, censor, cust, N, pres);
+      }
+    });
+  }
+  return res;
+}
@@ -0,0 +1,99 @@
+#ifndef BTYDPLUS_PARALLEL_H
+#define BTYDPLUS_PARALLEL_H
+
+#include <Rcpp.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <exception>
+#include "rng.h"
+#include "incomplete-gamma.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Runs `fn(block, begin, end)` for `threads` contiguous blocks of customers
+// [0, N), which only depend on N and `threads`. If the package is compiled
+// without OpenMP the blocks are processed one after the other.
+//
+// `fn` must not call into R, i.e. no R's RNG, no allocation of R objects, no
+// Rf_error, and no nmath functions that may signal warnings via R, such as
+// Rf_pgamma and Rf_qgamma (see LogUpperGamma instead); errors are signalled by throwing a std::exception, which is caught
+// within the worker and re-thrown on the main thread. The fallbacks of
+// LogUpperGamma within `fn` are moved from the workers' counters to the one of
+// the calling thread, so that they are attributed to the caller, e.g. to the
+// chain whose phase is profiled.
+template <typename Fn>
+void parallel_ranges(int N, int threads, Fn fn) {
+  if (threads < 1) threads = 1;
+  std::vector<std::string> errors(threads);
+  std::vector<long long> fallbacks(threads, 0);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+#endif
+  for (int b = 0; b < threads; b++) {
+    int begin = static_cast<int>(static_cast<long long>(N) * b / threads);
+    int end = static_cast<int>(static_cast<long long>(N) * (b + 1) / threads);
+    long long& worker_fallbacks = log_upper_gamma_fallbacks();
+    long long fallbacks_before = worker_fallbacks;
+    try {
+      fn(b, begin, end);
+    } catch (std::exception& e) {
+      errors[b] = e.what();
+    }
+    fallbacks[b] = worker_fallbacks - fallbacks_before;
+    worker_fallbacks = fallbacks_before;
+  }
+  for (int b = 0; b < threads; b++) log_upper_gamma_fallbacks() += fallbacks[b];
+  for (int b = 0; b < threads; b++) {
+    if (!errors[b].empty()) Rcpp::stop(errors[b]);
+  }
+}
+
+// the Philox streams of a sweep over the customers, with one stream per
+// customer: the stream of customer `i` is keyed by `i`, with the sweep's seed
+// in the upper half of its counter (see Philox), so that it is the same
+// whichever thread, and whichever batch of customers in lock-step, draws from
+// it. `at(i)` restarts the stream of customer `i`, and `lanes(b, n)` the ones
+// of the `n` customers starting at `b`, i.e. the generators of a batch.
+class CustomerStreams {
+public:
+  CustomerStreams(uint64_t seed, int width) : seed_(seed), rng_(0, seed), lanes_(width, rng_) {}
+
+  inline Philox& at(int i) {
+    rng_ = Philox(static_cast<uint64_t>(i), seed_);
+    return rng_;
+  }
+
+  inline Philox* lanes(int b, int n) {
+    for (int j = 0; j < n; j++) lanes_[j] = Philox(static_cast<uint64_t>(b + j), seed_);
+    return lanes_.data();
+  }
+
+private:
+  uint64_t seed_;
+  Philox rng_;
+  std::vector<Philox> lanes_;
+};
+
+// Runs `fn(streams, begin, end)` for the blocks of parallel_ranges, with
+// `begin` being a multiple of `width`, e.g. SIMD_WIDTH for samplers that draw
+// for batches of customers in lock-step. The seed of the streams is taken
+// from R's global RNG on the calling thread, once per call, i.e. once per
+// phase of each sweep, so that parallel_streams must be called from the main
+// thread. As each customer draws from its own stream, results are
+// reproducible for a given seed, regardless of the number of threads > 1 and
+// of `width`, and with or without OpenMP.
+template <typename Fn>
+void parallel_streams(int N, int threads, int width, Fn fn) {
+  if (width < 1) width = 1;
+  uint64_t seed = seed_from_r_rng();
+  int chunks = (N + width - 1) / width;
+  parallel_ranges(chunks, threads, [&](int, int begin, int end) {
+    CustomerStreams streams(seed, width);
+    fn(streams, begin * width, std::min(N, end * width));
+  });
+}
+
+#endif
@@ -0,0 +1,395 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "slice-sampling.h"
+#include "parallel.h"
+#include "pareto-ggg.h"
+#include "customer-state.h"
+#include "profile.h"
+#include "progress.h"
+#include "chains.h"
+
+using namespace Rcpp;
+
+// ********* Pareto / GGG MCMC chain **********
+
+// Runs a single MCMC chain for the Pareto/GGG model, incl. burnin and thinning,
+// and returns the draws in the same layout as `run_single_chain` in
+// R/pareto-ggg-mcmc.R used to store them: `level_1` is an array of dimension
+// (draws, 5, customers) with parameters k, lambda, mu, tau, z, and `level_2` a
+// matrix with columns t, gamma, r, alpha, s, beta.
+//
+// `state` is the customer state (see customer-state.h), which holds the data
+// and the initial customer-level parameters, and which is updated in place;
+// `hyper` holds the hyper priors (t_1, t_2, gamma_1, gamma_2, r_1, r_2,
+// alpha_1, alpha_2, s_1, s_2, beta_1, beta_2).
+//
+// With threads = 1 the random numbers are drawn from R's RNG in exactly the
+// same order as the former R implementation. Results for a given seed are not
+// bit-identical to it though, as the upper tail of the gamma distribution is
+// computed by LogUpperGamma rather than Rf_pgamma. With more threads, each
+// customer draws from its own Philox stream (see parallel_streams), also
+// within the batches of SIMD_WIDTH customers that are slice sampled in
+// lock-step, so that results do not depend on the number of threads. `palive_rule` selects the quadrature rule for P(alive), see
+// pggg_palive_rule in pareto-ggg.h.
+//
+// If `adaptive` is TRUE, the slice widths of k and lambda adapt to each
+// customer's posterior scale during burnin (see AdaptiveSliceWidth). `evals`
+// returns the number of log-density evaluations of the slice samplers for k
+// and lambda after burnin, to assess the efficiency of the slice widths, and
+// `exhausted` the number of their draws that ran out of the evaluation budget.
+// `slice_method` ("stepping-out" or "doubling") and `slice_max_evals` are
+// passed to these samplers, see SliceControl in slice-sampling.h.
+//
+// If `profile` is TRUE, `profile` returns the time spent in, and the metrics of
+// the slice samplers of each of the phases "k", "lambda", "mu", "tau" (incl.
+// P(alive) and z) and "level_2" of all steps, incl. burnin, see profile.h.
+// With threads > 1, mu, z and tau are drawn in a single pass, that is timed as
+// phase "mu". The chain is compiled with and without instrumentation, so that
+// it costs nothing if disabled.
+//
+// The chain checks for user interrupts at each step, and every
+// InterruptPoll::every customers within the single-threaded slice sampling
+// sweeps. If interrupted, it stops, and returns the draws collected so far,
+// with `interrupted` set to TRUE. Every `trace` steps, the progress is printed
+// together with the throughput in steps and customers per second.
+//
+// The steps of the chain are run by pggg_chain_loop, that draws either from R's
+// RNG, or from a Xoshiro256 stream, if the chain runs as one of several
+// threads (see chains.h and pggg_mcmc_chains).
+//
+// If `summarize` is TRUE, the customer-level draws are not returned; instead,
+// `summary` returns their online summaries, see ChainSummary in chains.h,
+// with `palive` being the mean of P(alive) given the parameters of each draw.
+
+enum pggg_phase { PGGG_PHASE_K, PGGG_PHASE_LAMBDA, PGGG_PHASE_MU, PGGG_PHASE_TAU, PGGG_PHASE_LEVEL_2 };
+
+template <bool Profile, typename Rng>
+ChainResult pggg_chain_loop(CustomerState* cs, const double* level_2_init, const double* hyper,
+                            int mcmc, int burnin, int thin, int chain_id, int trace, int threads,
+                            pggg_palive_rule rule, bool adaptive, const SliceControl& ctl,
+                            Rng& rrng, ChainProfile<Profile>& profile, const ChainIO& io) {
+  int N = cs->N;
+  int nr_of_draws = (mcmc - 1) / thin + 1;
+  const double *px = cs->x.data(), *ptx = cs->tx.data(), *pTcal = cs->Tcal.data();
+  const double *plitt = cs->litt.data();
+  double *k = cs->k.data(), *lambda = cs->lambda.data(), *mu = cs->mu.data();
+  double *tau = cs->tau.data(), *z = cs->z.data();
+  std::vector<double> p_alive(z, z + N);
+  double t = level_2_init[0], gamma = level_2_init[1];
+  double r = level_2_init[2], alpha = level_2_init[3];
+  double s = level_2_init[4], beta = level_2_init[5];
+
+  double* pl2 = io.level_2;
+
+  AdaptiveSliceWidth adapt_k(adaptive ? N : 0), adapt_lambda(adaptive ? N : 0);
+  std::vector<double> w_k(adaptive ? N : 0), w_lambda(adaptive ? N : 0);
+  std::atomic<long long> evals_k(0), evals_lambda(0), exhausted_k(0), exhausted_lambda(0);
+
+  ChainProgress progress(chain_id, io.main_thread ? trace : 0, burnin + mcmc, N);
+  InterruptPoll interrupt(io.stop, io.main_thread);
+  int stored = 0;
+
+  for (int step = 1; step <= burnin + mcmc; step++) {
+    if (interrupt.check()) break;
+    progress.report(step);
+
+    // store
+    if ((step - burnin) > 0 && (step - 1 - burnin) % thin == 0) {
+      int idx = (step - 1 - burnin) / thin;
+      stored = idx + 1;
+      for (int i=0; i<N; i++) {
+        double v[5] = {k[i], lambda[i], mu[i], tau[i], z[i]};
+        chain_store_level_1(io, nr_of_draws, N, 5, idx, i, v, p_alive[i]);
+      }
+      pl2[idx] = t;
+      pl2[idx + nr_of_draws] = gamma;
+      pl2[idx + 2 * nr_of_draws] = r;
+      pl2[idx + 3 * nr_of_draws] = alpha;
+      pl2[idx + 4 * nr_of_draws] = s;
+      pl2[idx + 5 * nr_of_draws] = beta;
+    }
+
+    // draw individual-level parameters
+    if (adaptive) {
+      for (int i=0; i<N; i++) {
+        w_k[i] = adapt_k.width(i, 3 * sqrt(t) / gamma);
+        w_lambda[i] = adapt_lambda.width(i, 3 * sqrt(r) / alpha);
+      }
+    }
+    bool count = step > burnin;
+    auto collect = [&](int phase, const SliceControl& c,
+                       std::atomic<long long>& evals, std::atomic<long long>& exhausted) {
+      profile.add(phase, c);
+      if (count) {
+        evals += c.evals;
+        exhausted += c.exhausted;
+      }
+    };
+    if (threads <= 1) {
+      SliceControl ck = ctl.options(), cl = ctl.options(), ct;
+      profile.start();
+      for (int i=0; i<N && !interrupt.poll(i); i++)
+        k[i] = pggg_draw_k(px[i], ptx[i], pTcal[i], plitt[i], k[i], lambda[i], tau[i], t, gamma, rrng,
+                           adaptive ? w_k[i] : 0, &ck);
+      profile.stop(PGGG_PHASE_K);
+      profile.start();
+      for (int i=0; i<N && !interrupt.poll(i); i++)
+        lambda[i] = pggg_draw_lambda(px[i], ptx[i], pTcal[i], k[i], lambda[i], tau[i], r, alpha, rrng,
+                                     adaptive ? w_lambda[i] : 0, &cl);
+      profile.stop(PGGG_PHASE_LAMBDA);
+      collect(PGGG_PHASE_K, ck, evals_k, exhausted_k);
+      collect(PGGG_PHASE_LAMBDA, cl, evals_lambda, exhausted_lambda);
+      // mu ~ gamma(s + 1, beta + tau), as rgamma(N, s + 1, beta + tau)
+      profile.start();
+      for (int i=0; i<N; i++) {
+        mu[i] = rrng.rgamma(s + 1, 1 / (beta + tau[i]));
+        if (mu[i] == 0 || log(mu[i]) < -30) mu[i] = exp(-30);  // avoid numeric overflow
+      }
+      profile.stop(PGGG_PHASE_MU);
+      // sample z; and then tau, first for all alive, and then for all churned
+      // customers, to consume the RNG in the same order as the R implementation
+      profile.start();
+      for (int i=0; i<N; i++) {
+        p_alive[i] = pggg_palive_cpp(px[i], ptx[i], pTcal[i], k[i], lambda[i], mu[i], rule);
+      }
+      for (int i=0; i<N; i++) {
+        z[i] = p_alive[i] > rrng.unif_rand() ? 1 : 0;
+      }
+      for (int i=0; i<N; i++) {
+        // still alive - left truncated exponential distribution -> [Tcal, Inf]
+        if (z[i] == 1) tau[i] = pTcal[i] + (1 / mu[i]) * rrng.exp_rand();
+      }
+      for (int i=0; i<N; i++) {
+        // churned - distribution of tau truncated to [tx, Tcal]
+        if (z[i] == 0) tau[i] = pggg_draw_tau(ptx[i], pTcal[i], k[i], lambda[i], mu[i], rrng,
+                                              profile.control(ct));
+      }
+      profile.stop(PGGG_PHASE_TAU);
+      profile.add(PGGG_PHASE_TAU, ct);
+    } else {
+      // k and lambda are slice sampled for batches of SIMD_WIDTH customers in
+      // lock-step
+      profile.start();
+      parallel_streams(N, threads, SIMD_WIDTH, [&](CustomerStreams& streams, int begin, int end) {
+        SliceControl ck = ctl.options();
+        for (int b=begin; b<end; b+=SIMD_WIDTH) {
+          int n = std::min(SIMD_WIDTH, end - b);
+          pggg_draw_k_batch(n, px+b, ptx+b, pTcal+b, plitt+b, k+b, lambda+b, tau+b, t, gamma,
+                            streams.lanes(b, n), adaptive ? w_k.data()+b : NULL, &ck);
+        }
+        collect(PGGG_PHASE_K, ck, evals_k, exhausted_k);
+      });
+      profile.stop(PGGG_PHASE_K);
+      profile.start();
+      parallel_streams(N, threads, SIMD_WIDTH, [&](CustomerStreams& streams, int begin, int end) {
+        SliceControl cl = ctl.options();
+        for (int b=begin; b<end; b+=SIMD_WIDTH) {
+          int n = std::min(SIMD_WIDTH, end - b);
+          pggg_draw_lambda_batch(n, px+b, ptx+b, pTcal+b, k+b, lambda+b, tau+b, r, alpha,
+                                 streams.lanes(b, n), adaptive ? w_lambda.data()+b : NULL, &cl);
+        }
+        collect(PGGG_PHASE_LAMBDA, cl, evals_lambda, exhausted_lambda);
+      });
+      profile.stop(PGGG_PHASE_LAMBDA);
+      // mu, z and tau only depend on the customer's own state, and are thus
+      // drawn in a single pass
+      profile.start();
+      parallel_streams(N, threads, 1, [&](CustomerStreams& streams, int begin, int end) {
+        SliceControl ct;
+        for (int i=begin; i<end; i++) {
+          Philox& rng = streams.at(i);
+          mu[i] = rng.rgamma(s + 1, 1 / (beta + tau[i]));
+          if (mu[i] == 0 || log(mu[i]) < -30) mu[i] = exp(-30);
+          double pa = pggg_palive_cpp(px[i], ptx[i], pTcal[i], k[i], lambda[i], mu[i], rule);
+          p_alive[i] = pa;
+          z[i] = pa > rng.unif_rand() ? 1 : 0;
+          if (z[i] == 1) {
+            tau[i] = pTcal[i] + rng.exp_rand() / mu[i];
+          } else {
+            tau[i] = pggg_draw_tau(ptx[i], pTcal[i], k[i], lambda[i], mu[i], rng, profile.control(ct));
+          }
+        }
+        profile.add(PGGG_PHASE_TAU, ct);
+      });
+      profile.stop(PGGG_PHASE_MU);
+    }
+    // an interrupt within the sweep over the customers leaves this step
+    // incomplete, and it is thus not stored
+    if (interrupt.interrupted()) break;
+    // z is re-derived from tau, as in the R implementation
+    for (int i=0; i<N; i++) {
+      z[i] = tau[i] > pTcal[i] ? 1 : 0;
+    }
+    if (adaptive && step <= burnin) {
+      for (int i=0; i<N; i++) {
+        adapt_k.update(i, k[i]);
+        adapt_lambda.update(i, lambda[i]);
+      }
+      adapt_k.next();
+      adapt_lambda.next();
+    }
+
+    // draw heterogeneity parameters, with the sufficient statistics of k,
+    // lambda and mu being computed in a single pass
+    profile.start();
+    SliceControl c2;
+    std::array<const double*, 3> level_1 = {{k, lambda, mu}};
+    std::array<GammaStats, 3> stats = gamma_stats(level_1, N, threads);
+    std::array<double, 2> draw;
+    draw = slice_sample_gamma_parameters_cpp(stats[0], t, gamma, hyper, 200, 0.1, rrng,
+                                             profile.control(c2));
+    t = draw[0];
+    gamma = draw[1];
+    draw = slice_sample_gamma_parameters_cpp(stats[1], r, alpha, hyper + 4, 200, 0.1, rrng,
+                                             profile.control(c2));
+    r = draw[0];
+    alpha = draw[1];
+    draw = slice_sample_gamma_parameters_cpp(stats[2], s, beta, hyper + 8, 200, 0.1, rrng,
+                                             profile.control(c2));
+    s = draw[0];
+    beta = draw[1];
+    profile.stop(PGGG_PHASE_LEVEL_2);
+    profile.add(PGGG_PHASE_LEVEL_2, c2);
+  }
+
+  ChainResult res = {{{evals_k.load(), evals_lambda.load()}}, {{exhausted_k.load(), exhausted_lambda.load()}},
+                     stored, interrupt.interrupted()};
+  return res;
+}
+
+inline List pggg_chain_result(const ChainResult& res, SEXP profile) {
+  NumericVector evals = NumericVector::create(_["k"] = static_cast<double>(res.evals[0]),
+                                              _["lambda"] = static_cast<double>(res.evals[1]));
+  NumericVector exhausted = NumericVector::create(_["k"] = static_cast<double>(res.exhausted[0]),
+                                                  _["lambda"] = static_cast<double>(res.exhausted[1]));
+  return List::create(_["evals"] = evals, _["exhausted"] = exhausted, _["profile"] = profile,
+                      _["interrupted"] = res.interrupted);
+}
+
+template <bool Profile>
+List pggg_run_chain(SEXP state, NumericVector level_2_init, NumericVector hyper,
+                    int mcmc, int burnin, int thin, int chain_id, int trace, int threads,
+                    std::string palive_rule, bool adaptive, std::string slice_method, int slice_max_evals,
+                    bool summarize) {
+  ChainProfile<Profile> profile({"k", "lambda", "mu", "tau", "level_2"});
+  pggg_palive_rule rule = pggg_palive_rule_from_string(palive_rule);
+  SliceControl ctl(slice_method_from_string(slice_method), slice_max_evals);
+  XPtr<CustomerState> cs(state);
+  int nr_of_draws = (mcmc - 1) / thin + 1;
+  NumericVector level_1_draws(Dimension(summarize ? 0 : nr_of_draws, 5, cs->N));
+  NumericMatrix level_2_draws(nr_of_draws, 6);
+  ChainIO io = {level_1_draws.begin(), level_2_draws.begin(), true, NULL, NULL, NULL, NULL, NULL};
+  ChainSummary summary(summarize, cs->N, 5);
+  summary.attach(io);
+  RRng rrng;
+  ChainResult res = pggg_chain_loop(cs.get(), level_2_init.begin(), hyper.begin(), mcmc, burnin, thin,
+                                    chain_id, trace, threads, rule, adaptive, ctl, rrng, profile, io);
+
+  // return the draws collected so far, if the chain was interrupted
+  RObject level_1_out = summarize ? RObject() : RObject(level_1_draws), level_2_out = level_2_draws;
+  if (res.interrupted) {
+    if (!summarize) level_1_out = head_draws(level_1_draws, res.stored);
+    level_2_out = head_draws(level_2_draws, res.stored);
+  }
+  List out = pggg_chain_result(res, profile.result());
+  out["summary"] = summary.result(res.stored);
+  out["level_1"] = level_1_out;
+  out["level_2"] = level_2_out;
+  return out;
+}
+
+// [[Rcpp::export]]
+List pggg_mcmc_chain(SEXP state, NumericVector level_2_init, NumericVector hyper,
+                     int mcmc, int burnin, int thin, int chain_id = 1, int trace = 100, int threads = 1,
+                     std::string palive_rule = "simpson", bool adaptive = false,
+                     std::string slice_method = "stepping-out", int slice_max_evals = 0,
+                     bool profile = false, bool summarize = false) {
+  if (profile)
+    return pggg_run_chain<true>(state, level_2_init, hyper, mcmc, burnin, thin, chain_id, trace, threads,
+                                palive_rule, adaptive, slice_method, slice_max_evals, summarize);
+  return pggg_run_chain<false>(state, level_2_init, hyper, mcmc, burnin, thin, chain_id, trace, threads,
+                               palive_rule, adaptive, slice_method, slice_max_evals, summarize);
+}
+
+// Runs the chains as threads, see chains.h; the customer states of `states`
+// and the rows of `level_2_init` are the initial states of the chains.
+// `level_1` returns the customer-level draws of all chains as array of
+// dimension (draws, 5, customers, chains), unless they are written to the
+// writable draw store file `store`; `level_2` the cohort-level draws as array
+// of dimension (draws, 6, chains), and `chains` the remaining return values of
+// pggg_mcmc_chain for each chain. Each chain draws from its own Xoshiro256
+// stream, and sweeps over its customers on a single thread. If interrupted,
+// `stored` returns the number of draws of each chain that were collected.
+template <bool Profile>
+List pggg_run_chains(List states, NumericMatrix level_2_init, NumericVector hyper,
+                     int mcmc, int burnin, int thin, int trace, std::string palive_rule, bool adaptive,
+                     std::string slice_method, int slice_max_evals, SEXP store, int chain_threads,
+                     bool summarize) {
+  int chains = states.size();
+  if (chains < 1 || level_2_init.nrow() != chains || level_2_init.ncol() != 6)
+    Rcpp::stop("level_2_init needs to be a matrix with 6 columns and a row for each chain");
+  std::vector<std::string> phases = {"k", "lambda", "mu", "tau", "level_2"};
+  pggg_palive_rule rule = pggg_palive_rule_from_string(palive_rule);
+  SliceControl ctl(slice_method_from_string(slice_method), slice_max_evals);
+  std::vector<CustomerState*> cs;
+  std::vector<std::vector<double> > init(chains, std::vector<double>(6));
+  std::vector<ChainProfile<Profile> > profiles;
+  std::vector<ChainSummary> summaries;
+  profiles.reserve(chains);
+  for (int c=0; c<chains; c++) {
+    XPtr<CustomerState> state(static_cast<SEXP>(states[c]));
+    cs.push_back(state.get());
+    if (cs[c]->N != cs[0]->N) Rcpp::stop("states need to hold the same customers");
+    for (int j=0; j<6; j++) init[c][j] = level_2_init(c, j);
+    profiles.emplace_back(phases);
+    summaries.push_back(ChainSummary(summarize, cs[c]->N, 5));
+  }
+  int nr_of_draws = (mcmc - 1) / thin + 1;
+  int dims[4] = {nr_of_draws, 5, cs[0]->N, chains};
+  NumericVector level_1_draws;
+  bool single = false;
+  void* pl1 = summarize ? NULL : chain_threads_store(store, level_1_draws, dims, single);
+  NumericVector level_2_draws(static_cast<R_xlen_t>(nr_of_draws) * 6 * chains);
+  level_2_draws.attr("dim") = IntegerVector::create(nr_of_draws, 6, chains);
+  double* pl2 = level_2_draws.begin();
+
+  std::vector<ChainResult> res(chains);
+  std::atomic<bool> stop(false);
+  run_chain_threads(chains, chain_threads, [&](int c, Xoshiro256& rng, bool main_thread) {
+    ChainIO io = {NULL, pl2 + static_cast<R_xlen_t>(nr_of_draws) * 6 * c, main_thread, &stop, NULL, NULL, NULL, NULL};
+    chain_attach_store(io, pl1, single, dims, c);
+    summaries[c].attach(io);
+    res[c] = pggg_chain_loop(cs[c], init[c].data(), hyper.begin(), mcmc, burnin, thin, c + 1, trace, 1,
+                             rule, adaptive, ctl, rng, profiles[c], io);
+  });
+
+  List chain_results(chains);
+  IntegerVector stored(chains);
+  bool interrupted = false;
+  for (int c=0; c<chains; c++) {
+    List chain_result = pggg_chain_result(res[c], profiles[c].result());
+    chain_result["summary"] = summaries[c].result(res[c].stored);
+    chain_results[c] = chain_result;
+    stored[c] = res[c].stored;
+    interrupted = interrupted || res[c].interrupted;
+  }
+  return List::create(_["level_1"] = store == R_NilValue && !summarize ? RObject(level_1_draws) : RObject(),
+                      _["level_2"] = level_2_draws, _["chains"] = chain_results,
+                      _["stored"] = stored, _["interrupted"] = interrupted);
+}
+
+// [[Rcpp::export]]
+List pggg_mcmc_chains(List states, NumericMatrix level_2_init, NumericVector hyper,
+                      int mcmc, int burnin, int thin, int trace = 100,
+                      std::string palive_rule = "simpson", bool adaptive = false,
+                      std::string slice_method = "stepping-out", int slice_max_evals = 0,
+                      bool profile = false, SEXP store = R_NilValue, int chain_threads = 1,
+                      bool summarize = false) {
+  if (profile)
+    return pggg_run_chains<true>(states, level_2_init, hyper, mcmc, burnin, thin, trace, palive_rule, adaptive,
+                                 slice_method, slice_max_evals, store, chain_threads, summarize);
+  return pggg_run_chains<false>(states, level_2_init, hyper, mcmc, burnin, thin, trace, palive_rule, adaptive,
+                                slice_method, slice_max_evals, store, chain_threads, summarize);
+}
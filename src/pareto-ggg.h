@@ -0,0 +1,378 @@
+#ifndef BTYDPLUS_PARETO_GGG_H
+#define BTYDPLUS_PARETO_GGG_H
+
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include "slice-sampling.h"
+#include "slice-sampling-batch.h"
+#include "incomplete-gamma.h"
+
+// ********* Pareto / GGG **********
+
+// customer-level kernels of the Pareto/GGG posterior, shared by the exported
+// samplers in slice-sampling.cpp and the MCMC driver in pareto-ggg-mcmc.cpp.
+// They operate on plain doubles, and only call lgamma and LogUpperGamma (see
+// incomplete-gamma.h) for the upper tail of the intertransaction times, so
+// they can be evaluated on worker threads. Each kernel sets up LogUpperGamma
+// once per shape, and shares its lgamma with the rest of the log-density.
+
+// integrand of the P(alive) denominator over y in [tx, Tcal], i.e. the upper
+// tail of the gamma distributed intertransaction time at y - tx, times exp(-mu y)
+struct pggg_palive_integrand {
+  double tx, rate, mu;
+  LogUpperGamma log_q;
+  pggg_palive_integrand(double tx_, double k, double lambda, double mu_)
+    : tx(tx_), rate(k * lambda), mu(mu_), log_q(k) {}
+  inline double operator()(double y) const {
+    return exp(log_q((y - tx) * rate) - mu * y);
+  }
+};
+
+template <typename Fn>
+inline double simpson38(const Fn& fn, double a, double b) {
+  // http://en.wikipedia.org/wiki/Simpson%27s_rule#Simpson.27s_3.2F8_rule_.28for_n_intervals.29
+  double n = 12.0;
+  double integral = (3.0/8.0) * ((b-a)/n) *
+    (fn(a) +
+    3 * fn(a+(1/n)*(b-a)) +
+    3 * fn(a+(2/n)*(b-a)) +
+    2 * fn(a+(3/n)*(b-a)) +
+    3 * fn(a+(4/n)*(b-a)) +
+    3 * fn(a+(5/n)*(b-a)) +
+    2 * fn(a+(6/n)*(b-a)) +
+    3 * fn(a+(7/n)*(b-a)) +
+    3 * fn(a+(8/n)*(b-a)) +
+    2 * fn(a+(9/n)*(b-a)) +
+    3 * fn(a+(10/n)*(b-a)) +
+    3 * fn(a+(11/n)*(b-a)) +
+    fn(b));
+  return(integral);
+}
+
+inline double pggg_palive_cpp(double /* x */, double tx, double Tcal, double k, double lambda, double mu) {
+  pggg_palive_integrand fn(tx, k, lambda, mu);
+  // calc numerator
+  double numer = fn(Tcal);
+  // calc denominator by integrating from tx to Tcal
+  // - we integrate numerically via Simpson3/8 rule (calling Rdqags crashed under Unix)
+  double integral = simpson38(fn, tx, Tcal);
+  double denom = numer + mu * integral;
+  return (numer/denom);
+}
+
+
+// P(alive) with a selectable quadrature rule for the integral in the
+// denominator. PGGG_PALIVE_SIMPSON is the 13-point Simpson 3/8 rule above, and
+// remains the default. PGGG_PALIVE_GAUSS_LEGENDRE uses 6-point Gauss-Legendre,
+// i.e. 7 instead of 14 pgamma calls per customer. PGGG_PALIVE_ADAPTIVE uses
+// adaptive Gauss-Kronrod (7-15) with a relative error bound of 1e-6, and is
+// meant for when Tcal - tx is long compared to the intertransaction times.
+enum pggg_palive_rule { PGGG_PALIVE_SIMPSON, PGGG_PALIVE_GAUSS_LEGENDRE, PGGG_PALIVE_ADAPTIVE };
+
+inline pggg_palive_rule pggg_palive_rule_from_string(const std::string& rule) {
+  if (rule == "simpson") return PGGG_PALIVE_SIMPSON;
+  if (rule == "gauss-legendre") return PGGG_PALIVE_GAUSS_LEGENDRE;
+  if (rule == "adaptive") return PGGG_PALIVE_ADAPTIVE;
+  throw std::invalid_argument("unknown P(alive) rule '" + rule + "'");
+}
+
+// customer-level constants of P(alive), computed once and shared by all
+// quadrature nodes; the integrand is taken over u = y - tx, and both numerator
+// and denominator are scaled by exp(mu*tx), which avoids their underflow for
+// large Tcal
+struct pggg_palive_integrand_u {
+  double D, k, scale, mu;
+  LogUpperGamma log_q;
+  pggg_palive_integrand_u(double tx, double Tcal, double k_, double lambda, double mu_)
+    : D(Tcal - tx), k(k_), scale(1 / (k_ * lambda)), mu(mu_), log_q(k_) {}
+  inline double operator()(double u) const {
+    return exp(log_q(u / scale) - mu * u);
+  }
+};
+
+template <typename Fn>
+inline double gauss_legendre6(const Fn& fn, double a, double b) {
+  static const double nodes[3] = { 0.2386191860831969086305017, 0.6612093864662645136613996,
+                                   0.9324695142031520278123016 };
+  static const double weights[3] = { 0.4679139345726910473898703, 0.3607615730481386075698335,
+                                     0.1713244923791703450402961 };
+  double c = (a + b) / 2, h = (b - a) / 2, sum = 0;
+  for (int i = 0; i < 3; i++) {
+    sum += weights[i] * (fn(c - h * nodes[i]) + fn(c + h * nodes[i]));
+  }
+  return sum * h;
+}
+
+// 15-point Kronrod estimate of the integral over [a, b]; `err` is set to an
+// error estimate derived from its difference to the embedded 7-point Gauss
+// estimate, following QUADPACK's qk15
+template <typename Fn>
+inline double gauss_kronrod15(const Fn& fn, double a, double b, double* err) {
+  static const double xk[8] = { 0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+                                0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+                                0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+                                0.207784955007898467600689403773245, 0.000000000000000000000000000000000 };
+  static const double wk[8] = { 0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+                                0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+                                0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+                                0.204432940075298892414161999234649, 0.209482141084727828012999174891714 };
+  static const double wg[4] = { 0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+                                0.381830050505118944950369775488975, 0.417959183673469387755102040816327 };
+  double c = (a + b) / 2, h = (b - a) / 2;
+  double fc = fn(c);
+  double kronrod = wk[7] * fc, gauss = wg[3] * fc;
+  for (int i = 0; i < 7; i++) {
+    double f = fn(c - h * xk[i]) + fn(c + h * xk[i]);
+    kronrod += wk[i] * f;
+    if (i % 2 == 1) gauss += wg[i / 2] * f;
+  }
+  double diff = fabs((kronrod - gauss) * h), resabs = fabs(kronrod * h);
+  *err = (resabs > 0) ? resabs * std::min(1.0, pow(200 * diff / resabs, 1.5)) : diff;
+  return kronrod * h;
+}
+
+// globally adaptive Gauss-Kronrod integration over [a, b]: the subinterval
+// with the largest error estimate is bisected, until the total error estimate
+// is below `rel_tol` times the integral, or `max_intervals` subintervals are in
+// use
+template <typename Fn>
+inline double adaptive_gauss_kronrod(const Fn& fn, double a, double b, double rel_tol) {
+  const int max_intervals = 32;
+  double lo[max_intervals], hi[max_intervals], integral[max_intervals], err[max_intervals];
+  int n = 1;
+  lo[0] = a;
+  hi[0] = b;
+  integral[0] = gauss_kronrod15(fn, a, b, &err[0]);
+  double total = integral[0], total_err = err[0];
+  while (total_err > rel_tol * fabs(total) && n < max_intervals) {
+    int worst = 0;
+    for (int i = 1; i < n; i++) {
+      if (err[i] > err[worst]) worst = i;
+    }
+    double m = (lo[worst] + hi[worst]) / 2;
+    total -= integral[worst];
+    total_err -= err[worst];
+    lo[n] = m;
+    hi[n] = hi[worst];
+    integral[n] = gauss_kronrod15(fn, m, hi[n], &err[n]);
+    hi[worst] = m;
+    integral[worst] = gauss_kronrod15(fn, lo[worst], m, &err[worst]);
+    total += integral[worst] + integral[n];
+    total_err += err[worst] + err[n];
+    n++;
+  }
+  return total;
+}
+
+inline double pggg_palive_cpp(double x, double tx, double Tcal, double k, double lambda, double mu,
+                              pggg_palive_rule rule) {
+  if (rule == PGGG_PALIVE_SIMPSON) return pggg_palive_cpp(x, tx, Tcal, k, lambda, mu);
+  pggg_palive_integrand_u fn(tx, Tcal, k, lambda, mu);
+  double numer = fn(fn.D);
+  // the integrand drops from 1 to 0 around the mean intertransaction time, and
+  // is negligible beyond `split`, i.e. 8 standard deviations plus 8 / (k*lambda)
+  // above it; Gauss-Legendre ignores that remainder, and the adaptive rule adds
+  // it with a single Gauss-Kronrod step
+  double split = std::min(fn.D, (k + 8 * sqrt(k) + 8) * fn.scale);
+  double integral;
+  if (rule == PGGG_PALIVE_GAUSS_LEGENDRE) {
+    integral = gauss_legendre6(fn, 0, split);
+  } else {
+    integral = adaptive_gauss_kronrod(fn, 0, split, 1e-6);
+    if (split < fn.D) {
+      double err;
+      integral += gauss_kronrod15(fn, split, fn.D, &err);
+    }
+  }
+  return numer / (numer + mu * integral);
+}
+
+
+// `log_q` is the LogUpperGamma of shape k
+inline double pggg_post_tau(double tau_, double k, double lambda, double mu, const LogUpperGamma& log_q) {
+  return(-mu*tau_ + log_q(tau_ * k * lambda));
+}
+
+
+inline double pggg_post_k(double k_, double x, double tx, double Tcal, double litt,
+                          double lambda, double tau, double t, double gamma) {
+  // the shape varies with k_, but its lgamma is shared with the tail
+  LogUpperGamma log_q(k_);
+  double log_one_minus_F = log_q((std::min(Tcal, tau) - tx) * k_ * lambda);
+  return (t-1) * log(k_) - (k_*gamma) +
+    k_ * x * log(k_*lambda) - x * log_q.lgamma_shape() - k_ * lambda * tx + (k_-1) * litt +
+    log_one_minus_F;
+}
+
+// `log_q` is the LogUpperGamma of shape k
+inline double pggg_post_lambda(double lambda_, double x, double tx, double Tcal,
+                               double k, double tau, double r, double alpha, const LogUpperGamma& log_q) {
+  double log_one_minus_F = log_q((std::min(Tcal, tau) - tx) * k * lambda_);
+  return (r-1) * log(lambda_) - (lambda_*alpha) +
+    k * x * log(lambda_) - k * lambda_ * tx +
+    log_one_minus_F;
+}
+
+
+// draws for a single customer
+
+// unless a positive slice width `w` is passed (see AdaptiveSliceWidth), the
+// width is derived from the cohort-level prior; `ctl` selects the slice
+// sampling method and evaluation budget, and collects the metrics (see
+// SliceControl)
+
+template <typename Rng>
+inline double pggg_draw_k(double x, double tx, double Tcal, double litt,
+                          double k, double lambda, double tau, double t, double gamma, Rng& rng,
+                          double w = 0, SliceControl* ctl = NULL) {
+  if (!(w > 0)) w = 3 * sqrt(t) / gamma;
+  auto logfn = [&](double k_) {
+    return pggg_post_k(k_, x, tx, Tcal, litt, lambda, tau, t, gamma);
+  };
+  return slice_sample_cpp(logfn, k, 3, w, 1e-1, 1e+3, rng, ctl);
+}
+
+template <typename Rng>
+inline double pggg_draw_lambda(double x, double tx, double Tcal,
+                               double k, double lambda, double tau, double r, double alpha, Rng& rng,
+                               double w = 0, SliceControl* ctl = NULL) {
+  if (!(w > 0)) w = 3 * sqrt(r) / alpha;
+  LogUpperGamma log_q(k);
+  auto logfn = [&](double lambda_) {
+    return pggg_post_lambda(lambda_, x, tx, Tcal, k, tau, r, alpha, log_q);
+  };
+  return slice_sample_cpp(logfn, lambda, 3, w, 1e-30, 1e+5, rng, ctl);
+}
+
+// the log-posteriors of k and lambda for the SIMD_WIDTH lanes of `k_`, resp.
+// `lambda_`, with one customer per lane, and `dt` = min(Tcal, tau) - tx; equal
+// to pggg_post_k and pggg_post_lambda up to the rounding of simd_log. Lanes
+// outside of the support are skipped.
+
+inline void pggg_post_k_batch(const double* k_, const double* x, const double* tx, const double* dt,
+                              const double* litt, const double* lambda, double t, double gamma,
+                              double* out) {
+  const int W = SIMD_WIDTH;
+  double kl[W], log_k[W], log_kl[W];
+  for (int j = 0; j < W; j++) kl[j] = k_[j] * lambda[j];
+  simd_log(k_, log_k);
+  simd_log(kl, log_kl);
+  for (int j = 0; j < W; j++) {
+    if (!(k_[j] > 0)) {
+      out[j] = -INFINITY;
+      continue;
+    }
+    LogUpperGamma log_q(k_[j]);
+    double log_one_minus_F = log_q(dt[j] * kl[j]);
+    out[j] = (t-1) * log_k[j] - (k_[j]*gamma) +
+      k_[j] * x[j] * log_kl[j] - x[j] * log_q.lgamma_shape() - kl[j] * tx[j] + (k_[j]-1) * litt[j] +
+      log_one_minus_F;
+  }
+}
+
+// `log_q` holds the LogUpperGamma of shape k of each lane
+inline void pggg_post_lambda_batch(const double* lambda_, const double* x, const double* tx, const double* dt,
+                                   const double* k, const LogUpperGamma* log_q, double r, double alpha,
+                                   double* out) {
+  const int W = SIMD_WIDTH;
+  double log_l[W];
+  simd_log(lambda_, log_l);
+  for (int j = 0; j < W; j++) {
+    if (!(lambda_[j] > 0)) {
+      out[j] = -INFINITY;
+      continue;
+    }
+    double log_one_minus_F = log_q[j](dt[j] * k[j] * lambda_[j]);
+    out[j] = (r-1) * log_l[j] - (lambda_[j]*alpha) +
+      k[j] * x[j] * log_l[j] - k[j] * lambda_[j] * tx[j] +
+      log_one_minus_F;
+  }
+}
+
+
+// batched draws for up to SIMD_WIDTH consecutive customers, as used by the
+// multi-threaded sweeps (see slice-sampling-batch.h); the logarithms are
+// vectorized, while lgamma and pgamma are still evaluated lane by lane, and
+// skipped for lanes outside of the support; `rng` holds one generator per
+// customer; `widths` and `ctl` are optional as for the draws of a single
+// customer, with one width per customer; the doubling procedure falls back to
+// the draws of a single customer
+
+template <typename Rng>
+inline void pggg_draw_k_batch(int n, const double* x, const double* tx, const double* Tcal,
+                              const double* litt, double* k, const double* lambda, const double* tau,
+                              double t, double gamma, Rng* rng,
+                              const double* widths = NULL, SliceControl* ctl = NULL) {
+  if (ctl != NULL && ctl->method == SLICE_DOUBLING) {
+    for (int i = 0; i < n; i++)
+      k[i] = pggg_draw_k(x[i], tx[i], Tcal[i], litt[i], k[i], lambda[i], tau[i], t, gamma, rng[i],
+                         widths != NULL ? widths[i] : 0, ctl);
+    return;
+  }
+  const int W = SIMD_WIDTH;
+  double xs[W], txs[W], dts[W], litts[W], lambdas[W], v[W], w[W];
+  for (int j = 0; j < W; j++) {
+    int i = j < n ? j : 0;
+    xs[j] = x[i];
+    txs[j] = tx[i];
+    dts[j] = std::min(Tcal[i], tau[i]) - tx[i];
+    litts[j] = litt[i];
+    lambdas[j] = lambda[i];
+    v[j] = k[i];
+    w[j] = (widths != NULL) ? widths[i] : 3 * sqrt(t) / gamma;
+  }
+  auto logfn = [&](const double* k_, double* out) {
+    pggg_post_k_batch(k_, xs, txs, dts, litts, lambdas, t, gamma, out);
+  };
+  slice_sample_batch(logfn, v, n, 3, w, 1e-1, 1e+3, rng, ctl);
+  std::copy(v, v + n, k);
+}
+
+template <typename Rng>
+inline void pggg_draw_lambda_batch(int n, const double* x, const double* tx, const double* Tcal,
+                                   const double* k, double* lambda, const double* tau,
+                                   double r, double alpha, Rng* rng,
+                                   const double* widths = NULL, SliceControl* ctl = NULL) {
+  if (ctl != NULL && ctl->method == SLICE_DOUBLING) {
+    for (int i = 0; i < n; i++)
+      lambda[i] = pggg_draw_lambda(x[i], tx[i], Tcal[i], k[i], lambda[i], tau[i], r, alpha, rng[i],
+                                   widths != NULL ? widths[i] : 0, ctl);
+    return;
+  }
+  const int W = SIMD_WIDTH;
+  double xs[W], txs[W], dts[W], ks[W], v[W], w[W];
+  LogUpperGamma log_q[W];
+  for (int j = 0; j < W; j++) {
+    int i = j < n ? j : 0;
+    xs[j] = x[i];
+    txs[j] = tx[i];
+    dts[j] = std::min(Tcal[i], tau[i]) - tx[i];
+    ks[j] = k[i];
+    log_q[j] = LogUpperGamma(k[i]);
+    v[j] = lambda[i];
+    w[j] = (widths != NULL) ? widths[i] : 3 * sqrt(r) / alpha;
+  }
+  auto logfn = [&](const double* lambda_, double* out) {
+    pggg_post_lambda_batch(lambda_, xs, txs, dts, ks, log_q, r, alpha, out);
+  };
+  slice_sample_batch(logfn, v, n, 3, w, 1e-30, 1e+5, rng, ctl);
+  std::copy(v, v + n, lambda);
+}
+
+// draw tau of a churned customer, i.e. on [tx, Tcal]; `ctl` collects the
+// metrics of the slice sampler
+template <typename Rng>
+inline double pggg_draw_tau(double tx, double Tcal, double k, double lambda, double mu, Rng& rng,
+                            SliceControl* ctl = NULL) {
+  double tau_init = std::min(Tcal-tx, rng.rgamma(k, 1/(k*lambda))) / 2;
+  LogUpperGamma log_q(k);
+  auto logfn = [&](double tau_) {
+    return pggg_post_tau(tau_, k, lambda, mu, log_q);
+  };
+  return tx + slice_sample_cpp(logfn, tau_init, 6, (Tcal-tx)/2, 0, Tcal-tx, rng, ctl);
+}
+
+#endif
@@ -0,0 +1,100 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "rng.h"
+#include "parallel.h"
+
+using namespace Rcpp;
+
+// ********* Pareto / NBD (Abe) **********
+
+// log-posterior of (log lambda, log mu) for a single customer, given z, tau,
+// the mean (m_lambda, m_mu) of the covariate regression, and the inverse
+// (ig11, ig12, ig22) of its covariance; with mu being capped at exp(5)
+inline double abe_log_post(double log_lambda, double log_mu, double x, double Tcal, double z, double tau,
+                           double m_lambda, double m_mu, double ig11, double ig12, double ig22) {
+  if (log_mu > 5) return -INFINITY;
+  double diff_lambda = log_lambda - m_lambda;
+  double diff_mu = log_mu - m_mu;
+  double likel = x * log_lambda + (1 - z) * log_mu - (exp(log_lambda) + exp(log_mu)) * (z * Tcal + (1 - z) * tau);
+  double prior = -0.5 * (diff_lambda * diff_lambda * ig11 +
+                         2 * diff_lambda * diff_mu * ig12 +
+                         diff_mu * diff_mu * ig22);
+  return likel + prior;
+}
+
+// Metropolis step of a single customer: the proposal is a t-distributed random
+// walk on (log lambda, log mu), with steps (step_lambda, step_mu), limited to
+// [-70, 70]; `u` is the uniform draw for the acceptance; `lambda` and `mu` are
+// updated in place
+inline void abe_metropolis(double& lambda, double& mu, double step_lambda, double step_mu, double u,
+                           double x, double Tcal, double z, double tau, double m_lambda, double m_mu,
+                           double ig11, double ig12, double ig22) {
+  double cur_log_lambda = log(lambda), cur_log_mu = log(mu);
+  double cur_post = abe_log_post(cur_log_lambda, cur_log_mu, x, Tcal, z, tau, m_lambda, m_mu, ig11, ig12, ig22);
+  double new_log_lambda = std::max(std::min(cur_log_lambda + step_lambda, 70.0), -70.0);
+  double new_log_mu = std::max(std::min(cur_log_mu + step_mu, 70.0), -70.0);
+  double new_post = abe_log_post(new_log_lambda, new_log_mu, x, Tcal, z, tau, m_lambda, m_mu, ig11, ig12, ig22);
+  bool accepted = exp(new_post - cur_post) > u;
+  lambda = exp(accepted ? new_log_lambda : cur_log_lambda);
+  mu = exp(accepted ? new_log_mu : cur_log_mu);
+}
+
+// Draws (lambda, mu) given (z, tau, beta, gamma) with a single Metropolis step
+// per customer, which replaces `draw_level_1` of R/pareto-nbd-abe.R. The mean
+// of the covariate regression is computed per customer, as the dot product of
+// its row of the [customer x covariate] matrix `covars` with the rows of the
+// [2 x covariate] matrix `beta`, so that no [customer x 2] matrix is built.
+// `gamma` is the covariance of (log lambda, log mu), and `inv_gamma` its
+// inverse, as computed in R.
+//
+// With threads = 1 the random numbers are drawn from R's RNG in the same order
+// as the former R implementation: first all t-distributed steps for lambda,
+// then those for mu, and then the uniform draws for the acceptance. With more
+// threads, proposal, log-posterior and acceptance are fused into a single pass
+// per customer, on the customer's own RNG stream of parallel_streams.
+// [[Rcpp::export]]
+List abe_draw_level_1_cpp(NumericVector x, NumericVector Tcal, NumericVector z, NumericVector tau,
+                          NumericVector lambda, NumericVector mu, NumericMatrix covars,
+                          NumericMatrix beta, NumericMatrix gamma, NumericMatrix inv_gamma,
+                          int threads = 1) {
+  int N = x.size(), K = covars.ncol();
+  if (covars.nrow() != N || beta.nrow() != 2 || beta.ncol() != K)
+    Rcpp::stop("covars needs to be of dimension [%d x K], and beta of [2 x K]", N);
+  NumericVector out_lambda = clone(lambda), out_mu = clone(mu);
+  const double *px = x.begin(), *pTcal = Tcal.begin(), *pz = z.begin(), *ptau = tau.begin();
+  const double *pcovars = covars.begin(), *pbeta = beta.begin();
+  double *plambda = out_lambda.begin(), *pmu = out_mu.begin();
+  double g11 = gamma(0, 0), g22 = gamma(1, 1);
+  double ig11 = inv_gamma(0, 0), ig12 = inv_gamma(0, 1), ig22 = inv_gamma(1, 1);
+
+  auto update = [&](int i, double step_lambda, double step_mu, double u) {
+    double m_lambda = 0, m_mu = 0;
+    for (int k=0; k<K; k++) {
+      double c = pcovars[i + static_cast<R_xlen_t>(N) * k];
+      m_lambda += c * pbeta[2 * k];
+      m_mu += c * pbeta[2 * k + 1];
+    }
+    abe_metropolis(plambda[i], pmu[i], step_lambda, step_mu, u, px[i], pTcal[i], pz[i], ptau[i],
+                   m_lambda, m_mu, ig11, ig12, ig22);
+  };
+
+  if (threads <= 1) {
+    RRng rng;
+    std::vector<double> step_lambda(N), step_mu(N);
+    for (int i=0; i<N; i++) step_lambda[i] = g11 * rng.rt(3);
+    for (int i=0; i<N; i++) step_mu[i] = g22 * rng.rt(3);
+    for (int i=0; i<N; i++) update(i, step_lambda[i], step_mu[i], rng.unif_rand());
+  } else {
+    parallel_streams(N, threads, 1, [&](CustomerStreams& streams, int begin, int end) {
+      for (int i=begin; i<end; i++) {
+        Philox& rng = streams.at(i);
+        double step_lambda = g11 * rng.rt(3);
+        double step_mu = g22 * rng.rt(3);
+        update(i, step_lambda, step_mu, rng.unif_rand());
+      }
+    });
+  }
+  return List::create(_["lambda"] = out_lambda, _["mu"] = out_mu);
+}
@@ -0,0 +1,363 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "slice-sampling.h"
+#include "parallel.h"
+#include "pareto-nbd.h"
+#include "customer-state.h"
+#include "profile.h"
+#include "progress.h"
+#include "chains.h"
+
+using namespace Rcpp;
+
+// ********* Pareto / NBD (HB) MCMC chain **********
+
+// Runs a single MCMC chain for the Pareto/NBD (HB) model, incl. burnin and
+// thinning, and returns the draws in the same layout as `run_single_chain` in
+// R/pareto-nbd-mcmc.R used to store them: `level_1` is an array of dimension
+// (draws, 4, customers) with parameters lambda, mu, tau, z, and `level_2` a
+// matrix with columns r, alpha, s, beta.
+//
+// `state` is the customer state (see customer-state.h), which holds the data
+// and the initial customer-level parameters, and which is updated in place;
+// `hyper` holds the hyper priors (r_1, r_2, alpha_1, alpha_2, s_1, s_2,
+// beta_1, beta_2). Customer-level rates are drawn via data augmentation if
+// `use_data_augmentation` is TRUE, and otherwise via slice sampling (Ma/Liu).
+//
+// With threads = 1 the random numbers are drawn from R's RNG in exactly the
+// same order as the former R implementation, so that results for a given seed
+// are unchanged. With more threads all customer-level parameters are updated
+// in a single pass over the customers, with the Ma/Liu slice samplers running
+// on batches of customers in lock-step (see slice-sampling-batch.h). Each
+// customer draws from its own Philox stream (see parallel_streams), so that
+// results do not depend on the number of threads.
+//
+// If `adaptive` is TRUE, the Ma/Liu slice widths of lambda and mu adapt to
+// each customer's posterior scale during burnin (see AdaptiveSliceWidth).
+// `evals` returns the number of log-density evaluations of the Ma/Liu slice
+// samplers for lambda and mu after burnin, and `exhausted` the number of their
+// draws that ran out of the evaluation budget. `slice_method` ("stepping-out"
+// or "doubling") and `slice_max_evals` are passed to these samplers, see
+// SliceControl in slice-sampling.h.
+//
+// If `profile` is TRUE, `profile` returns the time spent in, and the metrics of
+// the slice samplers of each of the phases "lambda", "mu", "tau" (incl. z) and
+// "level_2" of all steps, incl. burnin, see profile.h. With threads > 1, all
+// customer-level parameters are drawn in a single pass, that is timed as phase
+// "lambda". The chain is compiled with and without instrumentation, so that it
+// costs nothing if disabled.
+//
+// The chain checks for user interrupts at each step, and every
+// InterruptPoll::every customers within the single-threaded slice sampling
+// sweeps. If interrupted, it stops, and returns the draws collected so far,
+// with `interrupted` set to TRUE. Every `trace` steps, the progress is printed
+// together with the throughput in steps and customers per second.
+//
+// The steps of the chain are run by pnbd_chain_loop, that draws either from R's
+// RNG, or from a Xoshiro256 stream, if the chain runs as one of several
+// threads (see chains.h and pnbd_mcmc_chains).
+//
+// If `summarize` is TRUE, the customer-level draws are not returned; instead,
+// `summary` returns their online summaries, see ChainSummary in chains.h,
+// with `palive` being the mean of P(alive) given the parameters of each draw.
+
+enum pnbd_phase { PNBD_PHASE_LAMBDA, PNBD_PHASE_MU, PNBD_PHASE_TAU, PNBD_PHASE_LEVEL_2 };
+
+template <bool Profile, typename Rng>
+ChainResult pnbd_chain_loop(CustomerState* cs, const double* level_2_init, const double* hyper,
+                            int mcmc, int burnin, int thin, bool use_data_augmentation,
+                            int chain_id, int trace, int threads, bool adaptive, const SliceControl& ctl,
+                            Rng& rrng, ChainProfile<Profile>& profile, const ChainIO& io) {
+  int N = cs->N;
+  int nr_of_draws = (mcmc - 1) / thin + 1;
+  const double *px = cs->x.data(), *ptx = cs->tx.data(), *pTcal = cs->Tcal.data();
+  double *lambda = cs->lambda.data(), *mu = cs->mu.data();
+  double *tau = cs->tau.data(), *z = cs->z.data();
+  double r = level_2_init[0], alpha = level_2_init[1];
+  double s = level_2_init[2], beta = level_2_init[3];
+
+  double* pl2 = io.level_2;
+  std::vector<double> p_alive(z, z + N);
+
+  bool adapt = adaptive && !use_data_augmentation;
+  AdaptiveSliceWidth adapt_lambda(adapt ? N : 0), adapt_mu(adapt ? N : 0);
+  std::vector<double> w_lambda(adapt ? N : 0), w_mu(adapt ? N : 0);
+  std::atomic<long long> evals_lambda(0), evals_mu(0), exhausted_lambda(0), exhausted_mu(0);
+
+  ChainProgress progress(chain_id, io.main_thread ? trace : 0, burnin + mcmc, N);
+  InterruptPoll interrupt(io.stop, io.main_thread);
+  int stored = 0;
+
+  for (int step = 1; step <= burnin + mcmc; step++) {
+    if (interrupt.check()) break;
+    progress.report(step);
+
+    // store
+    if ((step - burnin) > 0 && (step - 1 - burnin) % thin == 0) {
+      int idx = (step - 1 - burnin) / thin;
+      stored = idx + 1;
+      for (int i=0; i<N; i++) {
+        double v[4] = {lambda[i], mu[i], tau[i], z[i]};
+        chain_store_level_1(io, nr_of_draws, N, 4, idx, i, v, p_alive[i]);
+      }
+      pl2[idx] = r;
+      pl2[idx + nr_of_draws] = alpha;
+      pl2[idx + 2 * nr_of_draws] = s;
+      pl2[idx + 3 * nr_of_draws] = beta;
+    }
+
+    // draw individual-level parameters
+    if (adapt) {
+      for (int i=0; i<N; i++) {
+        w_lambda[i] = adapt_lambda.width(i, 3 * sqrt(r) / alpha);
+        w_mu[i] = adapt_mu.width(i, 3 * sqrt(s) / beta);
+      }
+    }
+    bool count = step > burnin;
+    auto collect = [&](int phase, const SliceControl& c,
+                       std::atomic<long long>& evals, std::atomic<long long>& exhausted) {
+      profile.add(phase, c);
+      if (count) {
+        evals += c.evals;
+        exhausted += c.exhausted;
+      }
+    };
+    if (threads <= 1) {
+      if (use_data_augmentation) {
+        profile.start();
+        for (int i=0; i<N; i++)
+          lambda[i] = pnbd_draw_lambda(px[i], pTcal[i], tau[i], r, alpha, rrng);
+        profile.stop(PNBD_PHASE_LAMBDA);
+        profile.start();
+        for (int i=0; i<N; i++)
+          mu[i] = pnbd_draw_mu(tau[i], s, beta, rrng);
+        profile.stop(PNBD_PHASE_MU);
+      } else {
+        SliceControl cl = ctl.options(), cm = ctl.options();
+        profile.start();
+        for (int i=0; i<N && !interrupt.poll(i); i++)
+          lambda[i] = pnbd_draw_lambda_ma_liu(px[i], ptx[i], pTcal[i], lambda[i], mu[i], r, alpha, rrng,
+                                              adapt ? w_lambda[i] : 0, &cl);
+        profile.stop(PNBD_PHASE_LAMBDA);
+        profile.start();
+        for (int i=0; i<N && !interrupt.poll(i); i++)
+          mu[i] = pnbd_draw_mu_ma_liu(px[i], ptx[i], pTcal[i], lambda[i], mu[i], s, beta, rrng,
+                                      adapt ? w_mu[i] : 0, &cm);
+        profile.stop(PNBD_PHASE_MU);
+        collect(PNBD_PHASE_LAMBDA, cl, evals_lambda, exhausted_lambda);
+        collect(PNBD_PHASE_MU, cm, evals_mu, exhausted_mu);
+      }
+      // sample z; and then tau, first for all alive, and then for all churned
+      // customers, to consume the RNG in the same order as the R implementation
+      profile.start();
+      for (int i=0; i<N; i++) {
+        p_alive[i] = pnbd_palive(ptx[i], pTcal[i], lambda[i], mu[i]);
+        z[i] = p_alive[i] > rrng.unif_rand() ? 1 : 0;
+      }
+      for (int i=0; i<N; i++)
+        if (z[i] == 1) tau[i] = pnbd_draw_tau_alive(pTcal[i], mu[i], rrng);
+      for (int i=0; i<N; i++)
+        if (z[i] == 0) tau[i] = pnbd_draw_tau_churned(ptx[i], pTcal[i], lambda[i], mu[i], rrng);
+      profile.stop(PNBD_PHASE_TAU);
+    } else {
+      // customers are processed in batches of SIMD_WIDTH, so that the Ma/Liu
+      // log-posteriors can be evaluated in lock-step
+      profile.start();
+      parallel_streams(N, threads, SIMD_WIDTH, [&](CustomerStreams& streams, int begin, int end) {
+        SliceControl cl = ctl.options(), cm = ctl.options();
+        for (int b=begin; b<end; b+=SIMD_WIDTH) {
+          int n = std::min(SIMD_WIDTH, end - b);
+          Philox* rng = streams.lanes(b, n);
+          if (use_data_augmentation) {
+            for (int i=b; i<b+n; i++) {
+              lambda[i] = pnbd_draw_lambda(px[i], pTcal[i], tau[i], r, alpha, rng[i-b]);
+              mu[i] = pnbd_draw_mu(tau[i], s, beta, rng[i-b]);
+            }
+          } else {
+            pnbd_draw_lambda_ma_liu_batch(n, px+b, ptx+b, pTcal+b, lambda+b, mu+b, r, alpha, rng,
+                                          adapt ? w_lambda.data()+b : NULL, &cl);
+            pnbd_draw_mu_ma_liu_batch(n, px+b, ptx+b, pTcal+b, lambda+b, mu+b, s, beta, rng,
+                                      adapt ? w_mu.data()+b : NULL, &cm);
+          }
+          for (int i=b; i<b+n; i++) {
+            p_alive[i] = pnbd_palive(ptx[i], pTcal[i], lambda[i], mu[i]);
+            if (p_alive[i] > rng[i-b].unif_rand()) {
+              tau[i] = pnbd_draw_tau_alive(pTcal[i], mu[i], rng[i-b]);
+            } else {
+              tau[i] = pnbd_draw_tau_churned(ptx[i], pTcal[i], lambda[i], mu[i], rng[i-b]);
+            }
+          }
+        }
+        collect(PNBD_PHASE_LAMBDA, cl, evals_lambda, exhausted_lambda);
+        collect(PNBD_PHASE_MU, cm, evals_mu, exhausted_mu);
+      });
+      profile.stop(PNBD_PHASE_LAMBDA);
+    }
+    // an interrupt within the sweep over the customers leaves this step
+    // incomplete, and it is thus not stored
+    if (interrupt.interrupted()) break;
+    for (int i=0; i<N; i++) {
+      z[i] = tau[i] > pTcal[i] ? 1 : 0;
+    }
+    if (adapt && step <= burnin) {
+      for (int i=0; i<N; i++) {
+        adapt_lambda.update(i, lambda[i]);
+        adapt_mu.update(i, mu[i]);
+      }
+      adapt_lambda.next();
+      adapt_mu.next();
+    }
+
+    // draw heterogeneity parameters, with the sufficient statistics of lambda
+    // and mu being computed in a single pass
+    profile.start();
+    SliceControl c2;
+    std::array<const double*, 2> level_1 = {{lambda, mu}};
+    std::array<GammaStats, 2> stats = gamma_stats(level_1, N, threads);
+    std::array<double, 2> draw;
+    draw = slice_sample_gamma_parameters_cpp(stats[0], r, alpha, hyper, 50, 0.1, rrng,
+                                             profile.control(c2));
+    r = draw[0];
+    alpha = draw[1];
+    draw = slice_sample_gamma_parameters_cpp(stats[1], s, beta, hyper + 4, 50, 0.1, rrng,
+                                             profile.control(c2));
+    s = draw[0];
+    beta = draw[1];
+    profile.stop(PNBD_PHASE_LEVEL_2);
+    profile.add(PNBD_PHASE_LEVEL_2, c2);
+  }
+
+  ChainResult res = {{{evals_lambda.load(), evals_mu.load()}}, {{exhausted_lambda.load(), exhausted_mu.load()}},
+                     stored, interrupt.interrupted()};
+  return res;
+}
+
+inline List pnbd_chain_result(const ChainResult& res, SEXP profile) {
+  NumericVector evals = NumericVector::create(_["lambda"] = static_cast<double>(res.evals[0]),
+                                              _["mu"] = static_cast<double>(res.evals[1]));
+  NumericVector exhausted = NumericVector::create(_["lambda"] = static_cast<double>(res.exhausted[0]),
+                                                  _["mu"] = static_cast<double>(res.exhausted[1]));
+  return List::create(_["evals"] = evals, _["exhausted"] = exhausted, _["profile"] = profile,
+                      _["interrupted"] = res.interrupted);
+}
+
+template <bool Profile>
+List pnbd_run_chain(SEXP state, NumericVector level_2_init, NumericVector hyper,
+                    int mcmc, int burnin, int thin, bool use_data_augmentation,
+                    int chain_id, int trace, int threads, bool adaptive,
+                    std::string slice_method, int slice_max_evals, bool summarize) {
+  ChainProfile<Profile> profile({"lambda", "mu", "tau", "level_2"});
+  SliceControl ctl(slice_method_from_string(slice_method), slice_max_evals);
+  XPtr<CustomerState> cs(state);
+  int nr_of_draws = (mcmc - 1) / thin + 1;
+  NumericVector level_1_draws(Dimension(summarize ? 0 : nr_of_draws, 4, cs->N));
+  NumericMatrix level_2_draws(nr_of_draws, 4);
+  ChainIO io = {level_1_draws.begin(), level_2_draws.begin(), true, NULL, NULL, NULL, NULL, NULL};
+  ChainSummary summary(summarize, cs->N, 4);
+  summary.attach(io);
+  RRng rrng;
+  ChainResult res = pnbd_chain_loop(cs.get(), level_2_init.begin(), hyper.begin(), mcmc, burnin, thin,
+                                    use_data_augmentation, chain_id, trace, threads, adaptive, ctl,
+                                    rrng, profile, io);
+
+  // return the draws collected so far, if the chain was interrupted
+  RObject level_1_out = summarize ? RObject() : RObject(level_1_draws), level_2_out = level_2_draws;
+  if (res.interrupted) {
+    if (!summarize) level_1_out = head_draws(level_1_draws, res.stored);
+    level_2_out = head_draws(level_2_draws, res.stored);
+  }
+  List out = pnbd_chain_result(res, profile.result());
+  out["summary"] = summary.result(res.stored);
+  out["level_1"] = level_1_out;
+  out["level_2"] = level_2_out;
+  return out;
+}
+
+// [[Rcpp::export]]
+List pnbd_mcmc_chain(SEXP state, NumericVector level_2_init, NumericVector hyper,
+                     int mcmc, int burnin, int thin, bool use_data_augmentation = true,
+                     int chain_id = 1, int trace = 100, int threads = 1, bool adaptive = false,
+                     std::string slice_method = "stepping-out", int slice_max_evals = 0,
+                     bool profile = false, bool summarize = false) {
+  if (profile)
+    return pnbd_run_chain<true>(state, level_2_init, hyper, mcmc, burnin, thin, use_data_augmentation,
+                                chain_id, trace, threads, adaptive, slice_method, slice_max_evals, summarize);
+  return pnbd_run_chain<false>(state, level_2_init, hyper, mcmc, burnin, thin, use_data_augmentation,
+                               chain_id, trace, threads, adaptive, slice_method, slice_max_evals, summarize);
+}
+
+// Runs the chains as threads, see chains.h and pggg_mcmc_chains; `level_1`
+// has dimension (draws, 4, customers, chains), and `level_2` dimension
+// (draws, 4, chains).
+template <bool Profile>
+List pnbd_run_chains(List states, NumericMatrix level_2_init, NumericVector hyper,
+                     int mcmc, int burnin, int thin, bool use_data_augmentation, int trace, bool adaptive,
+                     std::string slice_method, int slice_max_evals, SEXP store, int chain_threads,
+                     bool summarize) {
+  int chains = states.size();
+  if (chains < 1 || level_2_init.nrow() != chains || level_2_init.ncol() != 4)
+    Rcpp::stop("level_2_init needs to be a matrix with 4 columns and a row for each chain");
+  std::vector<std::string> phases = {"lambda", "mu", "tau", "level_2"};
+  SliceControl ctl(slice_method_from_string(slice_method), slice_max_evals);
+  std::vector<CustomerState*> cs;
+  std::vector<std::vector<double> > init(chains, std::vector<double>(4));
+  std::vector<ChainProfile<Profile> > profiles;
+  std::vector<ChainSummary> summaries;
+  profiles.reserve(chains);
+  for (int c=0; c<chains; c++) {
+    XPtr<CustomerState> state(static_cast<SEXP>(states[c]));
+    cs.push_back(state.get());
+    if (cs[c]->N != cs[0]->N) Rcpp::stop("states need to hold the same customers");
+    for (int j=0; j<4; j++) init[c][j] = level_2_init(c, j);
+    profiles.emplace_back(phases);
+    summaries.push_back(ChainSummary(summarize, cs[c]->N, 4));
+  }
+  int nr_of_draws = (mcmc - 1) / thin + 1;
+  int dims[4] = {nr_of_draws, 4, cs[0]->N, chains};
+  NumericVector level_1_draws;
+  bool single = false;
+  void* pl1 = summarize ? NULL : chain_threads_store(store, level_1_draws, dims, single);
+  NumericVector level_2_draws(static_cast<R_xlen_t>(nr_of_draws) * 4 * chains);
+  level_2_draws.attr("dim") = IntegerVector::create(nr_of_draws, 4, chains);
+  double* pl2 = level_2_draws.begin();
+
+  std::vector<ChainResult> res(chains);
+  std::atomic<bool> stop(false);
+  run_chain_threads(chains, chain_threads, [&](int c, Xoshiro256& rng, bool main_thread) {
+    ChainIO io = {NULL, pl2 + static_cast<R_xlen_t>(nr_of_draws) * 4 * c, main_thread, &stop, NULL, NULL, NULL, NULL};
+    chain_attach_store(io, pl1, single, dims, c);
+    summaries[c].attach(io);
+    res[c] = pnbd_chain_loop(cs[c], init[c].data(), hyper.begin(), mcmc, burnin, thin, use_data_augmentation,
+                             c + 1, trace, 1, adaptive, ctl, rng, profiles[c], io);
+  });
+
+  List chain_results(chains);
+  IntegerVector stored(chains);
+  bool interrupted = false;
+  for (int c=0; c<chains; c++) {
+    List chain_result = pnbd_chain_result(res[c], profiles[c].result());
+    chain_result["summary"] = summaries[c].result(res[c].stored);
+    chain_results[c] = chain_result;
+    stored[c] = res[c].stored;
+    interrupted = interrupted || res[c].interrupted;
+  }
+  return List::create(_["level_1"] = store == R_NilValue && !summarize ? RObject(level_1_draws) : RObject(),
+                      _["level_2"] = level_2_draws, _["chains"] = chain_results,
+                      _["stored"] = stored, _["interrupted"] = interrupted);
+}
+
+// [[Rcpp::export]]
+List pnbd_mcmc_chains(List states, NumericMatrix level_2_init, NumericVector hyper,
+                      int mcmc, int burnin, int thin, bool use_data_augmentation = true,
+                      int trace = 100, bool adaptive = false,
+                      std::string slice_method = "stepping-out", int slice_max_evals = 0,
+                      bool profile = false, SEXP store = R_NilValue, int chain_threads = 1,
+                      bool summarize = false) {
+  if (profile)
+    return pnbd_run_chains<true>(states, level_2_init, hyper, mcmc, burnin, thin, use_data_augmentation, trace,
+                                 adaptive, slice_method, slice_max_evals, store, chain_threads, summarize);
+  return pnbd_run_chains<false>(states, level_2_init, hyper, mcmc, burnin, thin, use_data_augmentation, trace,
+                                adaptive, slice_method, slice_max_evals, store, chain_threads, summarize);
+}
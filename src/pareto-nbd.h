@@ -0,0 +1,225 @@
+#ifndef BTYDPLUS_PARETO_NBD_H
+#define BTYDPLUS_PARETO_NBD_H
+
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include "slice-sampling.h"
+#include "slice-sampling-batch.h"
+
+// ********* Pareto / NBD **********
+
+// customer-level kernels of the Pareto/NBD (HB) posterior, shared by the
+// exported samplers in slice-sampling.cpp and the MCMC driver in
+// pareto-nbd-mcmc.cpp. They operate on plain doubles and can be evaluated on
+// worker threads.
+
+
+// draw of individual-level posterior for Pareto/NBD (Ma/Liu)
+
+inline double post_lambda_ma_liu(double lambda_, double x, double tx, double Tcal,
+                                 double mu, double r, double alpha) {
+  if ( log(mu+lambda_) - log(mu) < 1e-10 ) {
+    return -INFINITY; // avoid numeric underflow
+  } else {
+    return (r-1) * log(lambda_) - (lambda_*alpha) +
+      x * log(lambda_) - log(lambda_+mu) +
+      log(mu*exp(-tx*(lambda_+mu))+lambda_*exp(-Tcal*(lambda_+mu)));
+  }
+}
+
+inline double post_mu_ma_liu(double mu_, double x, double tx, double Tcal,
+                             double lambda, double s, double beta) {
+  if ( log(lambda+mu_) - log(lambda) < 1e-10 ) {
+    return -INFINITY; // avoid numeric underflow
+  } else {
+    return (s-1) * log(mu_) - (mu_*beta) +
+      x * log(lambda) - log(lambda+mu_) +
+      log(mu_*exp(-tx*(lambda+mu_))+lambda*exp(-Tcal*(lambda+mu_)));
+  }
+}
+
+// the log-posteriors above for the SIMD_WIDTH lanes of `lambda_`, resp. `mu_`,
+// with one customer per lane, and `log_mu` = log(mu), resp. `log_lambda`,
+// precomputed; equal to the scalar ones up to the rounding of simd_log and
+// simd_exp
+
+inline void post_lambda_ma_liu_batch(const double* lambda_, const double* x, const double* tx,
+                                     const double* Tcal, const double* mu, const double* log_mu,
+                                     double r, double alpha, double* out) {
+  const int W = SIMD_WIDTH;
+  double lm[W], log_l[W], log_lm[W], e_tx[W], e_Tcal[W];
+  for (int j = 0; j < W; j++) {
+    lm[j] = lambda_[j] + mu[j];
+    e_tx[j] = -tx[j] * lm[j];
+    e_Tcal[j] = -Tcal[j] * lm[j];
+  }
+  simd_log(lambda_, log_l);
+  simd_log(lm, log_lm);
+  simd_exp(e_tx, e_tx);
+  simd_exp(e_Tcal, e_Tcal);
+  for (int j = 0; j < W; j++) e_tx[j] = mu[j] * e_tx[j] + lambda_[j] * e_Tcal[j];
+  simd_log(e_tx, e_tx);
+  for (int j = 0; j < W; j++) {
+    out[j] = (log_lm[j] - log_mu[j] < 1e-10) ? -INFINITY :  // avoid numeric underflow
+      (r-1) * log_l[j] - (lambda_[j]*alpha) + x[j] * log_l[j] - log_lm[j] + e_tx[j];
+  }
+}
+
+inline void post_mu_ma_liu_batch(const double* mu_, const double* x, const double* tx,
+                                 const double* Tcal, const double* lambda, const double* log_lambda,
+                                 double s, double beta, double* out) {
+  const int W = SIMD_WIDTH;
+  double lm[W], log_m[W], log_lm[W], e_tx[W], e_Tcal[W];
+  for (int j = 0; j < W; j++) {
+    lm[j] = lambda[j] + mu_[j];
+    e_tx[j] = -tx[j] * lm[j];
+    e_Tcal[j] = -Tcal[j] * lm[j];
+  }
+  simd_log(mu_, log_m);
+  simd_log(lm, log_lm);
+  simd_exp(e_tx, e_tx);
+  simd_exp(e_Tcal, e_Tcal);
+  for (int j = 0; j < W; j++) e_tx[j] = mu_[j] * e_tx[j] + lambda[j] * e_Tcal[j];
+  simd_log(e_tx, e_tx);
+  for (int j = 0; j < W; j++) {
+    out[j] = (log_lm[j] - log_lambda[j] < 1e-10) ? -INFINITY :  // avoid numeric underflow
+      (s-1) * log_m[j] - (mu_[j]*beta) + x[j] * log_lambda[j] - log_lm[j] + e_tx[j];
+  }
+}
+
+// unless a positive slice width `w` is passed (see AdaptiveSliceWidth), the
+// width is derived from the cohort-level prior; `ctl` selects the slice
+// sampling method and evaluation budget, and collects the metrics (see
+// SliceControl)
+
+template <typename Rng>
+inline double pnbd_draw_lambda_ma_liu(double x, double tx, double Tcal, double lambda, double mu,
+                                      double r, double alpha, Rng& rng,
+                                      double w = 0, SliceControl* ctl = NULL) {
+  if (!(w > 0)) w = 3 * sqrt(r) / alpha;
+  auto logfn = [&](double lambda_) {
+    return post_lambda_ma_liu(lambda_, x, tx, Tcal, mu, r, alpha);
+  };
+  return slice_sample_cpp(logfn, lambda, 3, w, 1e-5, 1e+5, rng, ctl);
+}
+
+template <typename Rng>
+inline double pnbd_draw_mu_ma_liu(double x, double tx, double Tcal, double lambda, double mu,
+                                  double s, double beta, Rng& rng,
+                                  double w = 0, SliceControl* ctl = NULL) {
+  if (!(w > 0)) w = 3 * sqrt(s) / beta;
+  auto logfn = [&](double mu_) {
+    return post_mu_ma_liu(mu_, x, tx, Tcal, lambda, s, beta);
+  };
+  return slice_sample_cpp(logfn, mu, 6, w, 1e-5, 1e+5, rng, ctl);
+}
+
+// batched draws for up to SIMD_WIDTH consecutive customers, as used by the
+// multi-threaded sweeps; the log-posteriors are the same as above, but
+// evaluated for all lanes at once (see slice-sampling-batch.h); `rng` holds
+// one generator per customer; `widths` and `ctl` are optional as above, with
+// one width per customer; the doubling procedure falls back to the draws of a
+// single customer
+
+template <typename Rng>
+inline void pnbd_draw_lambda_ma_liu_batch(int n, const double* x, const double* tx, const double* Tcal,
+                                          double* lambda, const double* mu,
+                                          double r, double alpha, Rng* rng,
+                                          const double* widths = NULL, SliceControl* ctl = NULL) {
+  if (ctl != NULL && ctl->method == SLICE_DOUBLING) {
+    for (int i = 0; i < n; i++)
+      lambda[i] = pnbd_draw_lambda_ma_liu(x[i], tx[i], Tcal[i], lambda[i], mu[i], r, alpha, rng[i],
+                                          widths != NULL ? widths[i] : 0, ctl);
+    return;
+  }
+  const int W = SIMD_WIDTH;
+  double xs[W], txs[W], Tcals[W], mus[W], log_mu[W], v[W], w[W];
+  for (int j = 0; j < W; j++) {
+    int i = j < n ? j : 0;
+    xs[j] = x[i];
+    txs[j] = tx[i];
+    Tcals[j] = Tcal[i];
+    mus[j] = mu[i];
+    v[j] = lambda[i];
+    w[j] = (widths != NULL) ? widths[i] : 3 * sqrt(r) / alpha;
+  }
+  simd_log(mus, log_mu);
+  auto logfn = [&](const double* lambda_, double* out) {
+    post_lambda_ma_liu_batch(lambda_, xs, txs, Tcals, mus, log_mu, r, alpha, out);
+  };
+  slice_sample_batch(logfn, v, n, 3, w, 1e-5, 1e+5, rng, ctl);
+  std::copy(v, v + n, lambda);
+}
+
+template <typename Rng>
+inline void pnbd_draw_mu_ma_liu_batch(int n, const double* x, const double* tx, const double* Tcal,
+                                      const double* lambda, double* mu,
+                                      double s, double beta, Rng* rng,
+                                      const double* widths = NULL, SliceControl* ctl = NULL) {
+  if (ctl != NULL && ctl->method == SLICE_DOUBLING) {
+    for (int i = 0; i < n; i++)
+      mu[i] = pnbd_draw_mu_ma_liu(x[i], tx[i], Tcal[i], lambda[i], mu[i], s, beta, rng[i],
+                                  widths != NULL ? widths[i] : 0, ctl);
+    return;
+  }
+  const int W = SIMD_WIDTH;
+  double xs[W], txs[W], Tcals[W], lambdas[W], log_l[W], v[W], w[W];
+  for (int j = 0; j < W; j++) {
+    int i = j < n ? j : 0;
+    xs[j] = x[i];
+    txs[j] = tx[i];
+    Tcals[j] = Tcal[i];
+    lambdas[j] = lambda[i];
+    v[j] = mu[i];
+    w[j] = (widths != NULL) ? widths[i] : 3 * sqrt(s) / beta;
+  }
+  simd_log(lambdas, log_l);
+  auto logfn = [&](const double* mu_, double* out) {
+    post_mu_ma_liu_batch(mu_, xs, txs, Tcals, lambdas, log_l, s, beta, out);
+  };
+  slice_sample_batch(logfn, v, n, 6, w, 1e-5, 1e+5, rng, ctl);
+  std::copy(v, v + n, mu);
+}
+
+
+// draw of individual-level posterior for Pareto/NBD (with data augmentation)
+
+// avoid numeric overflow
+inline double pnbd_floor_rate(double rate) {
+  return (rate == 0 || log(rate) < -30) ? exp(-30) : rate;
+}
+
+template <typename Rng>
+inline double pnbd_draw_lambda(double x, double Tcal, double tau, double r, double alpha, Rng& rng) {
+  return pnbd_floor_rate(rng.rgamma(r + x, 1 / (alpha + std::min(tau, Tcal))));
+}
+
+template <typename Rng>
+inline double pnbd_draw_mu(double tau, double s, double beta, Rng& rng) {
+  return pnbd_floor_rate(rng.rgamma(s + 1, 1 / (beta + tau)));
+}
+
+inline double pnbd_palive(double tx, double Tcal, double lambda, double mu) {
+  double mu_lam = mu + lambda;
+  return 1 / (1 + (mu / mu_lam) * (exp(mu_lam * (Tcal - tx)) - 1));
+}
+
+// still alive - left truncated exponential distribution -> [Tcal, Inf]
+template <typename Rng>
+inline double pnbd_draw_tau_alive(double Tcal, double mu, Rng& rng) {
+  return Tcal + (1 / mu) * rng.exp_rand();
+}
+
+// churned - double truncated exponential distribution -> [tx, Tcal]; sampled
+// with http://en.wikipedia.org/wiki/Inverse_transform_sampling
+template <typename Rng>
+inline double pnbd_draw_tau_churned(double tx, double Tcal, double lambda, double mu, Rng& rng) {
+  double mu_lam = mu + lambda;
+  double mu_lam_tx = std::min(mu_lam * tx, 700.0);
+  double mu_lam_Tcal = std::min(mu_lam * Tcal, 700.0);
+  double rand = rng.unif_rand();
+  return -log((1 - rand) * exp(-mu_lam_tx) + rand * exp(-mu_lam_Tcal)) / mu_lam;
+}
+
+#endif
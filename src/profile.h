@@ -0,0 +1,103 @@
+#ifndef BTYDPLUS_PROFILE_H
+#define BTYDPLUS_PROFILE_H
+
+#include <Rcpp.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "slice-sampling.h"
+#include "incomplete-gamma.h"
+
+// opt-in instrumentation of the MCMC chains
+//
+// The chains are templated over `ChainProfile<Enabled>`, so that the
+// instrumentation is selected at compile time: ChainProfile<false> consists of
+// empty inline member functions, which the compiler removes, and its
+// `control()` returns NULL, so that samplers without an evaluation budget are
+// called exactly as without instrumentation.
+//
+// Each Gibbs step is split into phases, one for each parameter that is drawn,
+// e.g. "k", "lambda", "mu", "tau" and "level_2". Per phase, ChainProfile<true>
+// accumulates the wall-clock time between start() and stop(), and the metrics
+// of the slice samplers (see SliceControl) that are passed to add(). It also
+// counts the evaluations of LogUpperGamma that fell back to Rf_pgamma during
+// the phase; otherwise the upper tail of the gamma distribution is computed by
+// LogUpperGamma itself, once per log-density evaluation. The fallbacks are
+// taken from the per-thread counter of the chain's thread, so that chains that
+// run as threads do not count each other's. add() may be called
+// from worker threads, while start() and stop() must only be called on the
+// main thread.
+template <bool Enabled>
+class ChainProfile;
+
+template <>
+class ChainProfile<false> {
+public:
+  explicit ChainProfile(const std::vector<std::string>& /* phases */) {}
+  inline void start() {}
+  inline void stop(int /* phase */) {}
+  inline void add(int /* phase */, const SliceControl& /* ctl */) {}
+  inline SliceControl* control(SliceControl& /* ctl */) const { return NULL; }
+  inline SEXP result() const { return R_NilValue; }
+};
+
+template <>
+class ChainProfile<true> {
+public:
+  enum metric { EVALS, EXPANSIONS, SHRINKS, DRAWS, EXHAUSTED, PGAMMA, METRICS };
+
+  explicit ChainProfile(const std::vector<std::string>& phases)
+    : phases_(phases), counts_(phases.size() * METRICS), ns_(phases.size(), 0), pgamma_(0) {
+    for (std::size_t i = 0; i < counts_.size(); i++) counts_[i].store(0);
+  }
+
+  inline void start() {
+    pgamma_ = log_upper_gamma_fallbacks();
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  inline void stop(int phase) {
+    ns_[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start_).count();
+    counts_[phase * METRICS + PGAMMA] += log_upper_gamma_fallbacks() - pgamma_;
+  }
+
+  inline void add(int phase, const SliceControl& ctl) {
+    std::atomic<long long>* c = &counts_[phase * METRICS];
+    c[EVALS] += ctl.evals;
+    c[EXPANSIONS] += ctl.expansions;
+    c[SHRINKS] += ctl.shrinks;
+    c[DRAWS] += ctl.draws;
+    c[EXHAUSTED] += ctl.exhausted;
+  }
+
+  // `ctl` for samplers, whose metrics are only needed for the profile
+  inline SliceControl* control(SliceControl& ctl) const { return &ctl; }
+
+  // list of `counts`, a [phase x metric] matrix, and `time`, the nanoseconds
+  // spent per phase
+  inline SEXP result() const {
+    int P = phases_.size();
+    Rcpp::NumericMatrix counts(P, static_cast<int>(METRICS));
+    Rcpp::NumericVector time(P);
+    for (int p = 0; p < P; p++) {
+      for (int m = 0; m < METRICS; m++) counts(p, m) = static_cast<double>(counts_[p * METRICS + m]);
+      time[p] = static_cast<double>(ns_[p]);
+    }
+    Rcpp::CharacterVector names = Rcpp::wrap(phases_);
+    counts.attr("dimnames") = Rcpp::List::create(
+      names, Rcpp::CharacterVector::create("evals", "expansions", "shrinks", "draws", "exhausted", "pgamma"));
+    time.attr("names") = names;
+    return Rcpp::List::create(Rcpp::_["counts"] = counts, Rcpp::_["time"] = time);
+  }
+
+private:
+  std::vector<std::string> phases_;
+  std::vector<std::atomic<long long> > counts_;
+  std::vector<long long> ns_;
+  long long pgamma_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef BTYDPLUS_PROGRESS_H
+#define BTYDPLUS_PROGRESS_H
+
+#include <Rcpp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+
+// interrupt checks and progress reports of the long-running C++ loops
+//
+// Rcpp::checkUserInterrupt throws, which unwinds the loop and discards all
+// results. The MCMC chains instead check via R_ToplevelExec, which returns
+// whether the user interrupted, so that the chain can stop at the current step
+// and return the draws collected so far. All checks must only be done on the
+// main thread, i.e. not from within parallel_streams; see InterruptPoll for
+// chains that run as threads.
+
+inline void check_interrupt_fn(void* /* data */) {
+  R_CheckUserInterrupt();
+}
+
+// TRUE if the user interrupted, e.g. by pressing Ctrl-C; does not throw
+inline bool user_interrupted() {
+  return R_ToplevelExec(check_interrupt_fn, NULL) == FALSE;
+}
+
+// amortized interrupt checks within the loops over the customers, so that a
+// single sweep over a large cohort can be cancelled; once interrupted, all
+// further checks return TRUE
+//
+// For chains that run as threads (see chains.h), `stop` is shared between the
+// chains: the chain on the main thread checks for user interrupts and sets
+// it, while the chains on the other threads only read it, as they must not
+// call into R.
+class InterruptPoll {
+public:
+  static const int every = 4096;
+
+  explicit InterruptPoll(std::atomic<bool>* stop = NULL, bool main_thread = true)
+    : interrupted_(false), main_thread_(main_thread), stop_(stop) {}
+
+  // checks for an interrupt every `every` customers
+  inline bool poll(int i) {
+    if (!interrupted_ && (i + 1) % every == 0) check();
+    return interrupted_;
+  }
+
+  // checks for an interrupt right away
+  inline bool check() {
+    if (interrupted_) return true;
+    if (main_thread_) interrupted_ = user_interrupted();
+    if (stop_ != NULL) {
+      if (interrupted_) stop_->store(true);
+      else interrupted_ = stop_->load();
+    }
+    return interrupted_;
+  }
+
+  inline bool interrupted() const { return interrupted_; }
+
+private:
+  bool interrupted_, main_thread_;
+  std::atomic<bool>* stop_;
+};
+
+// Runs `fn(begin, end)` for consecutive chunks of InterruptPoll::every
+// customers of [0, N), with a (throwing) interrupt check before each chunk;
+// for the single-threaded loops of the exported kernels, which have no
+// partial results to return
+template <typename Fn>
+void interruptible_chunks(int N, Fn fn) {
+  for (int begin = 0; begin < N; begin += InterruptPoll::every) {
+    Rcpp::checkUserInterrupt();
+    fn(begin, std::min(N, begin + InterruptPoll::every));
+  }
+}
+
+// progress of an MCMC chain, reported every `trace` steps together with its
+// throughput, in steps and customers per second since the previous report
+class ChainProgress {
+public:
+  ChainProgress(int chain_id, int trace, int steps, int N)
+    : chain_id_(chain_id), trace_(trace), steps_(steps), N_(N), last_step_(0),
+      last_(std::chrono::steady_clock::now()) {}
+
+  inline void report(int step) {
+    if (trace_ <= 0 || step % trace_ != 0) return;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(now - last_).count();
+    double steps_per_sec = secs > 0 ? (step - last_step_) / secs : 0;
+    std::streamsize precision = Rcpp::Rcout.precision();
+    Rcpp::Rcout << "chain: " << chain_id_ << " step: " << step << " of " << steps_
+                << std::fixed << std::setprecision(1)
+                << " (" << steps_per_sec << " steps/s, " << steps_per_sec * N_ << " customers/s) \n";
+    Rcpp::Rcout.unsetf(std::ios_base::floatfield);
+    Rcpp::Rcout.precision(precision);
+    last_step_ = step;
+    last_ = now;
+  }
+
+private:
+  int chain_id_, trace_, steps_, N_, last_step_;
+  std::chrono::steady_clock::time_point last_;
+};
+
+// the first `n` draws of `draws`, an array of dimension (draw, ...), e.g. of a
+// chain that was interrupted
+inline Rcpp::NumericVector head_draws(Rcpp::NumericVector draws, int n) {
+  Rcpp::IntegerVector dims = draws.attr("dim");
+  R_xlen_t nr_of_draws = dims[0], rest = draws.size() / std::max(dims[0], 1);
+  Rcpp::IntegerVector out_dims = Rcpp::clone(dims);
+  out_dims[0] = n;
+  Rcpp::NumericVector out(static_cast<R_xlen_t>(n) * rest);
+  for (R_xlen_t j = 0; j < rest; j++)
+    std::copy(draws.begin() + j * nr_of_draws, draws.begin() + j * nr_of_draws + n, out.begin() + j * n);
+  out.attr("dim") = out_dims;
+  return out;
+}
+
+#endif
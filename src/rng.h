@@ -0,0 +1,210 @@
+#ifndef BTYDPLUS_RNG_H
+#define BTYDPLUS_RNG_H
+
+#include <Rcpp.h>
+#include <cmath>
+#include <cstdint>
+
+// random number generators for the C++ samplers
+//
+// All samplers are templated over the generator, which needs to provide
+// `unif_rand()` on (0, 1), `exp_rand()`, `norm_rand()`, `rgamma(shape,
+// scale)` and `rt(df)`.
+//
+// - RRng forwards to R's global RNG, and thus respects `set.seed`. It must only
+//   be used from the main thread.
+// - Xoshiro256 is a small, self-contained generator (xoshiro256++ by Blackman
+//   & Vigna, http://prng.di.unimi.it/), which is used for MCMC chains that run
+//   as threads, with one stream per chain, see chains.h.
+// - Philox is a counter-based generator, which is used for multi-threaded
+//   sweeps over the customers, with one stream per customer and phase of a
+//   sweep, see parallel_streams in parallel.h. Streams are thus independent
+//   of how the customers are assigned to threads, and results with threads > 1
+//   are reproducible for a given seed regardless of the number of threads.
+//
+// Xoshiro256 and Philox derive their distributions from uniform 64-bit words
+// via RngDistributions.
+
+struct RRng {
+  inline double unif_rand() { return ::unif_rand(); }
+  inline double exp_rand() { return ::exp_rand(); }
+  inline double norm_rand() { return ::norm_rand(); }
+  inline double rgamma(double shape, double scale) { return ::Rf_rgamma(shape, scale); }
+  inline double rt(double df) { return ::Rf_rt(df); }
+};
+
+// the distributions of a generator `Derived`, that provides `next()`, i.e.
+// uniform 64-bit words
+template <typename Derived>
+class RngDistributions {
+public:
+  // uniform on the open interval (0, 1)
+  inline double unif_rand() {
+    return ((self().next() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+  }
+
+  inline double exp_rand() {
+    return -log(unif_rand());
+  }
+
+  // Marsaglia's polar method
+  inline double norm_rand() {
+    double u, v, q;
+    do {
+      u = 2 * unif_rand() - 1;
+      v = 2 * unif_rand() - 1;
+      q = u * u + v * v;
+    } while (q >= 1 || q == 0);
+    return u * sqrt(-2 * log(q) / q);
+  }
+
+  // Marsaglia & Tsang (2000), with the usual boost for shape < 1
+  inline double rgamma(double shape, double scale) {
+    if (shape < 1) {
+      double u = unif_rand();
+      return rgamma(1 + shape, scale) * pow(u, 1 / shape);
+    }
+    double d = shape - 1.0 / 3.0;
+    double c = 1 / sqrt(9 * d);
+    for (;;) {
+      double z, v;
+      do {
+        z = norm_rand();
+        v = 1 + c * z;
+      } while (v <= 0);
+      v = v * v * v;
+      double u = unif_rand();
+      if (u < 1 - 0.0331 * z * z * z * z) return d * v * scale;
+      if (log(u) < 0.5 * z * z + d * (1 - v + log(v))) return d * v * scale;
+    }
+  }
+
+  // Student t with `df` degrees of freedom, drawn as R's rt(), i.e. as a
+  // normal divided by the square root of a chi-squared draw over `df`
+  inline double rt(double df) {
+    double num = norm_rand();
+    return num / sqrt(rgamma(df / 2, 2.0) / df);
+  }
+
+private:
+  inline Derived& self() { return static_cast<Derived&>(*this); }
+};
+
+class Xoshiro256 : public RngDistributions<Xoshiro256> {
+public:
+  explicit Xoshiro256(uint64_t seed) {
+    // seed the state via splitmix64, as recommended by the authors
+    for (int i = 0; i < 4; i++) {
+      seed += 0x9e3779b97f4a7c15ULL;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      s[i] = z ^ (z >> 31);
+    }
+  }
+
+  inline uint64_t next() {
+    const uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+  // advance the state by 2^128 steps; used to split off non-overlapping streams
+  void jump() {
+    static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                     0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 0; i < 4; i++) {
+      for (int b = 0; b < 64; b++) {
+        if (JUMP[i] & (UINT64_C(1) << b)) {
+          s0 ^= s[0];
+          s1 ^= s[1];
+          s2 ^= s[2];
+          s3 ^= s[3];
+        }
+        next();
+      }
+    }
+    s[0] = s0;
+    s[1] = s1;
+    s[2] = s2;
+    s[3] = s3;
+  }
+
+private:
+  uint64_t s[4];
+  static inline uint64_t rotl(const uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+};
+
+// Philox4x32-10 (Salmon et al. 2011, "Parallel random numbers: as easy as 1,
+// 2, 3"), a counter-based generator: block `n` of stream `stream` is the
+// encryption of the 128-bit counter (n, stream) under the 64-bit `key`, with
+// 10 rounds of multiplications and xors. A stream thus needs no state besides
+// its counter, and any stream can be created in constant time, e.g. one keyed
+// by each customer, with the seed of the sweep as `stream`. Each block yields
+// 4 32-bit words, which are buffered.
+class Philox : public RngDistributions<Philox> {
+public:
+  Philox(uint64_t key, uint64_t stream) : n_(0), pos_(4) {
+    key_[0] = static_cast<uint32_t>(key);
+    key_[1] = static_cast<uint32_t>(key >> 32);
+    stream_[0] = static_cast<uint32_t>(stream);
+    stream_[1] = static_cast<uint32_t>(stream >> 32);
+  }
+
+  inline uint64_t next() {
+    uint64_t hi = next32();
+    return (hi << 32) | next32();
+  }
+
+  inline uint32_t next32() {
+    if (pos_ == 4) {
+      block(n_++, buf_);
+      pos_ = 0;
+    }
+    return buf_[pos_++];
+  }
+
+  // block `n` of the stream, i.e. the 4 words that follow the first 4 * n
+  // words
+  inline void block(uint64_t n, uint32_t* out) const {
+    uint32_t c[4] = {static_cast<uint32_t>(n), static_cast<uint32_t>(n >> 32), stream_[0], stream_[1]};
+    uint32_t k0 = key_[0], k1 = key_[1];
+    for (int round = 0; round < 10; round++) {
+      uint64_t p0 = static_cast<uint64_t>(0xD2511F53U) * c[0];
+      uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57U) * c[2];
+      uint32_t c0 = static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k0;
+      uint32_t c2 = static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k1;
+      c[0] = c0;
+      c[1] = static_cast<uint32_t>(p1);
+      c[2] = c2;
+      c[3] = static_cast<uint32_t>(p0);
+      k0 += 0x9E3779B9U;
+      k1 += 0xBB67AE85U;
+    }
+    for (int i = 0; i < 4; i++) out[i] = c[i];
+  }
+
+private:
+  uint32_t key_[2], stream_[2];
+  uint64_t n_;
+  uint32_t buf_[4];
+  int pos_;
+};
+
+// draw a 64-bit seed from R's RNG, so that `set.seed` controls the streams
+inline uint64_t seed_from_r_rng() {
+  uint64_t hi = static_cast<uint64_t>(::unif_rand() * 4294967296.0);
+  uint64_t lo = static_cast<uint64_t>(::unif_rand() * 4294967296.0);
+  return (hi << 32) ^ lo;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include <Rcpp.h>
+#include <cmath>
+#include "draw-store.h"
+#include "parallel.h"
+#include "pareto-nbd.h"
+
+using namespace Rcpp;
+
+// ********* scoring **********
+
+// Rao-Blackwellized per-customer scores of a Pareto/NBD type model, i.e.
+// with exponentially distributed intertransaction times and lifetimes. For
+// each draw of (lambda, mu) the closed forms
+//   P(alive) = pnbd_palive(tx, Tcal, lambda, mu)
+//   E[X*]    = P(alive) * lambda / mu * (1 - exp(-mu * Tstar))
+//   P(X*>0)  = P(alive) * lambda / (lambda + mu) * (1 - exp(-(lambda + mu) * Tstar))
+// are evaluated and averaged over all draws of all chains; the first `offset`
+// draws of each chain are skipped. Results are written to row `cust` of the
+// (customer x 3) matrix `out`. `T` is the value type of the store.
+template <typename T>
+inline void score_pnbd_customer(const DrawStoreView& v, int cust, int lambda_idx, int mu_idx, int offset,
+                                double tx, double Tcal, double Tstar, double* out, int N) {
+  double palive = 0, xstar = 0, pactive = 0;
+  for (int chain=0; chain<v.nr_of_chains; chain++) {
+    const T* lambda = v.draws<T>(lambda_idx, cust, chain);
+    const T* mu = v.draws<T>(mu_idx, cust, chain);
+    for (int draw=offset; draw<v.nr_of_draws; draw++) {
+      double l = lambda[draw], m = mu[draw];
+      double pa = pnbd_palive(tx, Tcal, l, m);
+      double mu_lam = l + m;
+      palive += pa;
+      xstar += pa * l / m * -std::expm1(-m * Tstar);
+      pactive += pa * l / mu_lam * -std::expm1(-mu_lam * Tstar);
+    }
+  }
+  double n = static_cast<double>(v.nr_of_draws - offset) * v.nr_of_chains;
+  out[cust] = palive / n;
+  out[cust + N] = xstar / n;
+  out[cust + 2 * N] = pactive / n;
+}
+
+// Scores all customers of the draw `store` (see draw-store.h) in a single
+// pass, on `threads` OpenMP threads. `lambda` and `mu` are the (1-based)
+// indices of these parameters within the store. Returns a matrix of
+// dimension (customers, 3) with the posterior means of P(alive), of the
+// expected number of transactions in the next `Tstar` time units, and of
+// P(active).
+// [[Rcpp::export]]
+NumericMatrix mcmc_score_pnbd_cpp(SEXP store, int lambda, int mu, NumericVector tx, NumericVector Tcal,
+                                  NumericVector Tstar, int offset = 0, int threads = 1) {
+  DrawStoreView v = draw_store_view(store);
+  int N = v.nr_of_cust;
+  if (lambda < 1 || lambda > v.nr_of_params || mu < 1 || mu > v.nr_of_params)
+    Rcpp::stop("lambda and mu need to be within 1 and %d", v.nr_of_params);
+  if (offset < 0 || offset >= v.nr_of_draws) Rcpp::stop("offset needs to be within 0 and %d", v.nr_of_draws - 1);
+  if (tx.size() != N || Tcal.size() != N || Tstar.size() != N)
+    Rcpp::stop("tx, Tcal and Tstar need to be of length %d", N);
+  NumericMatrix scores(N, 3);
+  double* out = scores.begin();
+  const double *ptx = tx.begin(), *pTcal = Tcal.begin(), *pTstar = Tstar.begin();
+  parallel_ranges(N, threads, [&](int, int begin, int end) {
+    for (int cust=begin; cust<end; cust++) {
+      if (v.single) {
+        score_pnbd_customer<float>(v, cust, lambda - 1, mu - 1, offset, ptx[cust], pTcal[cust], pTstar[cust],
+                                   out, N);
+      } else {
+        score_pnbd_customer<double>(v, cust, lambda - 1, mu - 1, offset, ptx[cust], pTcal[cust], pTstar[cust],
+                                    out, N);
+      }
+    }
+  });
+  return scores;
+}
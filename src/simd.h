@@ -0,0 +1,259 @@
+#ifndef BTYDPLUS_SIMD_H
+#define BTYDPLUS_SIMD_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// vectorized log and exp over a batch of SIMD_WIDTH lanes
+//
+// These use Cephes-style polynomial approximations, which are accurate to
+// about one ulp. On AVX2 capable CPUs they are evaluated on four doubles at
+// once. Otherwise the same operations are evaluated lane by lane in portable
+// scalar code, so that results do not depend on whether the CPU supports
+// AVX2, e.g. for the multi-threaded draws of the MCMC samplers. (That holds
+// as long as the compiler does not contract the scalar code into fused
+// multiply-adds, which does not happen for the default flags on x86-64.)
+// Arguments and results are plain arrays of length SIMD_WIDTH, so that
+// callers do not depend on the intrinsics.
+//
+// If the package is compiled with AVX2 enabled (e.g. `-mavx2` or
+// `-march=native` in ~/.R/Makevars), the AVX2 kernels are used
+// unconditionally, and are inlined. Otherwise, with GCC or clang on x86
+// (except for Windows, where the stack of the toolchain is not aligned for
+// AVX), the kernels are compiled for AVX2 via the target attribute, and are
+// selected at runtime if the CPU supports AVX2, so that a default build is
+// vectorized as well.
+
+#if defined(__AVX2__)
+#define BTYDPLUS_SIMD_AVX2
+#define BTYDPLUS_AVX2_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(_WIN32)
+#define BTYDPLUS_SIMD_AVX2
+#define BTYDPLUS_SIMD_DISPATCH
+#define BTYDPLUS_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#ifdef BTYDPLUS_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+static const int SIMD_WIDTH = 4;
+
+// the Cephes coefficients of exp, and of log on [sqrt(1/2) - 1, sqrt(2) - 1]
+static const double SIMD_EXP_P[] = { 1.26177193074810590878E-4, 3.02994407707441961300E-2,
+                                     9.99999999999999999910E-1 };
+static const double SIMD_EXP_Q[] = { 3.00198505138664455042E-6, 2.52448340349684104192E-3,
+                                     2.27265548208155028766E-1, 2.00000000000000000009E0 };
+static const double SIMD_LOG_P[] = { 1.01875663804580931796E-4, 4.97494994976747001425E-1,
+                                     4.70579119878881725854E0, 1.44989225341610930846E1,
+                                     1.79368678507819816313E1, 7.70838733755885391666E0 };
+static const double SIMD_LOG_Q[] = { 1.0, 1.12873587189167450590E1, 4.52279145837532221105E1,
+                                     8.29875266912776603211E1, 7.11544750618563894466E1,
+                                     2.31251620126765340583E1 };
+
+inline double simd_polevl(double x, const double* c, int n) {
+  double y = c[0];
+  for (int i = 1; i <= n; i++) y = y * x + c[i];
+  return y;
+}
+
+inline double simd_pow2(int n) {
+  uint64_t bits = static_cast<uint64_t>(n + 1023) << 52;
+  double d;
+  std::memcpy(&d, &bits, sizeof(d));
+  return d;
+}
+
+// the scalar kernels perform the same operations, in the same order, as the
+// AVX2 kernels below
+inline double simd_exp1(double x) {
+  if (!(x >= -7.08396418532264106224E2) || !(x <= 7.09782712893383996843E2)) return std::exp(x);
+  double n = std::floor(1.4426950408889634073599 * x + 0.5);
+  x = x - n * 6.93145751953125E-1;
+  x = x - n * 1.42860682030941723212E-6;
+  double xx = x * x;
+  double px = x * simd_polevl(xx, SIMD_EXP_P, 2);
+  double r = px / (simd_polevl(xx, SIMD_EXP_Q, 3) - px);
+  r = 1.0 + (r + r);
+  int n1 = static_cast<int>(std::floor(n * 0.5));
+  int n2 = static_cast<int>(n) - n1;
+  return (r * simd_pow2(n1)) * simd_pow2(n2);
+}
+
+inline double simd_log1(double x) {
+  if (!(x >= 2.2250738585072014e-308) || !(x <= 1.7976931348623157e308)) return std::log(x);
+  uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  double e = static_cast<double>(static_cast<int>(bits >> 52) - 1022);
+  bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FE0000000000000ULL;
+  double m;
+  std::memcpy(&m, &bits, sizeof(m));
+  if (m < 0.70710678118654752440) {
+    e = e - 1.0;
+    m = (m + m) - 1.0;
+  } else {
+    m = m - 1.0;
+  }
+  double z = m * m;
+  double y = (m * (z * simd_polevl(m, SIMD_LOG_P, 5))) / simd_polevl(m, SIMD_LOG_Q, 5);
+  y = y + e * -2.121944400546905827679e-4;
+  y = y - 0.5 * z;
+  double r = m + y;
+  return r + e * 0.693359375;
+}
+
+inline void simd_log_scalar(const double* x, double* out) {
+  for (int i = 0; i < SIMD_WIDTH; i++) out[i] = simd_log1(x[i]);
+}
+
+inline void simd_exp_scalar(const double* x, double* out) {
+  for (int i = 0; i < SIMD_WIDTH; i++) out[i] = simd_exp1(x[i]);
+}
+
+#ifdef BTYDPLUS_SIMD_AVX2
+
+BTYDPLUS_AVX2_TARGET inline __m256d simd_polevl_pd(__m256d x, const double* c, int n) {
+  __m256d y = _mm256_set1_pd(c[0]);
+  for (int i = 1; i <= n; i++) {
+    y = _mm256_add_pd(_mm256_mul_pd(y, x), _mm256_set1_pd(c[i]));
+  }
+  return y;
+}
+
+// replaces the lanes in `mask` by the C library result
+BTYDPLUS_AVX2_TARGET inline __m256d simd_fixup(__m256d x, __m256d r, __m256d mask, double (*fn)(double)) {
+  double xs[4], rs[4], ms[4];
+  _mm256_storeu_pd(xs, x);
+  _mm256_storeu_pd(rs, r);
+  _mm256_storeu_pd(ms, mask);
+  for (int i = 0; i < 4; i++) {
+    uint64_t bits;
+    std::memcpy(&bits, &ms[i], sizeof(bits));
+    if (bits) rs[i] = fn(xs[i]);
+  }
+  return _mm256_loadu_pd(rs);
+}
+
+BTYDPLUS_AVX2_TARGET inline __m256d simd_exp_pd(__m256d x) {
+  const __m256d C1 = _mm256_set1_pd(6.93145751953125E-1);
+  const __m256d C2 = _mm256_set1_pd(1.42860682030941723212E-6);
+  const __m256d log2e = _mm256_set1_pd(1.4426950408889634073599);
+  const __m256d maxlog = _mm256_set1_pd(7.09782712893383996843E2);
+  const __m256d minlog = _mm256_set1_pd(-7.08396418532264106224E2);
+  // overflow, underflow into subnormals, and NaN are handled by blending in the
+  // C library results
+  __m256d special = _mm256_or_pd(_mm256_cmp_pd(x, minlog, _CMP_NGE_UQ), _mm256_cmp_pd(x, maxlog, _CMP_NLE_UQ));
+  __m256d xc = _mm256_min_pd(_mm256_max_pd(x, minlog), maxlog);
+  // express exp(x) as exp(g) * 2^n
+  __m256d n = _mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(log2e, xc), _mm256_set1_pd(0.5)));
+  xc = _mm256_sub_pd(xc, _mm256_mul_pd(n, C1));
+  xc = _mm256_sub_pd(xc, _mm256_mul_pd(n, C2));
+  __m256d xx = _mm256_mul_pd(xc, xc);
+  __m256d px = _mm256_mul_pd(xc, simd_polevl_pd(xx, SIMD_EXP_P, 2));
+  __m256d r = _mm256_div_pd(px, _mm256_sub_pd(simd_polevl_pd(xx, SIMD_EXP_Q, 3), px));
+  r = _mm256_add_pd(_mm256_set1_pd(1.0), _mm256_add_pd(r, r));
+  // multiply by 2^n; n is within [-1022, 1024], so split in two factors
+  __m128i ni = _mm256_cvtpd_epi32(n);
+  __m128i n1 = _mm_srai_epi32(ni, 1);
+  __m128i n2 = _mm_sub_epi32(ni, n1);
+  __m256i e1 = _mm256_slli_epi64(_mm256_add_epi64(_mm256_cvtepi32_epi64(n1), _mm256_set1_epi64x(1023)), 52);
+  __m256i e2 = _mm256_slli_epi64(_mm256_add_epi64(_mm256_cvtepi32_epi64(n2), _mm256_set1_epi64x(1023)), 52);
+  r = _mm256_mul_pd(_mm256_mul_pd(r, _mm256_castsi256_pd(e1)), _mm256_castsi256_pd(e2));
+  if (!_mm256_testz_pd(special, special)) r = simd_fixup(x, r, special, std::exp);
+  return r;
+}
+
+BTYDPLUS_AVX2_TARGET inline __m256d simd_log_pd(__m256d x) {
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d half = _mm256_set1_pd(0.5);
+  // special cases are handled by blending in the C library results
+  __m256d special = _mm256_or_pd(_mm256_cmp_pd(x, _mm256_set1_pd(2.2250738585072014e-308), _CMP_NGE_UQ),
+                                 _mm256_cmp_pd(x, _mm256_set1_pd(1.7976931348623157e308), _CMP_NLE_UQ));
+  // split into mantissa in [0.5, 1) and exponent
+  __m256i xi = _mm256_castpd_si256(x);
+  __m256i ei = _mm256_sub_epi64(_mm256_srli_epi64(xi, 52), _mm256_set1_epi64x(1022));
+  __m256i mi = _mm256_or_si256(_mm256_and_si256(xi, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                               _mm256_set1_epi64x(0x3FE0000000000000LL));
+  __m256d m = _mm256_castsi256_pd(mi);
+  // convert 64-bit exponents to double, via the low 32 bits of each lane
+  __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+  __m128i e32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(ei, idx));
+  __m256d e = _mm256_cvtepi32_pd(e32);
+  // if m < sqrt(1/2), then use 2m - 1 and e - 1, otherwise m - 1
+  __m256d small = _mm256_cmp_pd(m, _mm256_set1_pd(0.70710678118654752440), _CMP_LT_OQ);
+  e = _mm256_sub_pd(e, _mm256_and_pd(small, one));
+  m = _mm256_sub_pd(_mm256_add_pd(m, _mm256_and_pd(small, m)), one);
+  __m256d z = _mm256_mul_pd(m, m);
+  __m256d y = _mm256_div_pd(_mm256_mul_pd(m, _mm256_mul_pd(z, simd_polevl_pd(m, SIMD_LOG_P, 5))), simd_polevl_pd(m, SIMD_LOG_Q, 5));
+  y = _mm256_add_pd(y, _mm256_mul_pd(e, _mm256_set1_pd(-2.121944400546905827679e-4)));
+  y = _mm256_sub_pd(y, _mm256_mul_pd(half, z));
+  __m256d r = _mm256_add_pd(m, y);
+  r = _mm256_add_pd(r, _mm256_mul_pd(e, _mm256_set1_pd(0.693359375)));
+  if (!_mm256_testz_pd(special, special)) r = simd_fixup(x, r, special, std::log);
+  return r;
+}
+
+BTYDPLUS_AVX2_TARGET inline void simd_log_avx2(const double* x, double* out) {
+  _mm256_storeu_pd(out, simd_log_pd(_mm256_loadu_pd(x)));
+}
+
+BTYDPLUS_AVX2_TARGET inline void simd_exp_avx2(const double* x, double* out) {
+  _mm256_storeu_pd(out, simd_exp_pd(_mm256_loadu_pd(x)));
+}
+
+#endif
+
+// whether the CPU supports the AVX2 kernels; checked once per process, as the
+// CPU (and the support of the OS for the AVX state) does not change
+inline bool simd_avx2_supported() {
+#if defined(BTYDPLUS_SIMD_DISPATCH)
+  static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+  return supported;
+#elif defined(BTYDPLUS_SIMD_AVX2)
+  return true;
+#else
+  return false;
+#endif
+}
+
+inline bool& simd_avx2_enabled() {
+  static bool enabled = simd_avx2_supported();
+  return enabled;
+}
+
+// whether the AVX2 kernels are used
+inline bool simd_avx2() {
+  return simd_avx2_enabled();
+}
+
+// enables or disables the AVX2 kernels, e.g. to compare them with the
+// portable ones; they can only be enabled if supported by the CPU. This must
+// only be called on the main thread, while no kernels are evaluated.
+inline bool simd_set_avx2(bool enable) {
+  bool before = simd_avx2_enabled();
+  simd_avx2_enabled() = enable && simd_avx2_supported();
+  return before;
+}
+
+inline void simd_log(const double* x, double* out) {
+#ifdef BTYDPLUS_SIMD_AVX2
+  if (simd_avx2()) {
+    simd_log_avx2(x, out);
+    return;
+  }
+#endif
+  simd_log_scalar(x, out);
+}
+
+inline void simd_exp(const double* x, double* out) {
+#ifdef BTYDPLUS_SIMD_AVX2
+  if (simd_avx2()) {
+    simd_exp_avx2(x, out);
+    return;
+  }
+#endif
+  simd_exp_scalar(x, out);
+}
+
+#endif
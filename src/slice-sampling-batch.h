@@ -0,0 +1,156 @@
+#ifndef BTYDPLUS_SLICE_SAMPLING_BATCH_H
+#define BTYDPLUS_SLICE_SAMPLING_BATCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "simd.h"
+#include "slice-sampling.h"
+
+// lock-step slice sampling of SIMD_WIDTH independent univariate targets
+//
+// This runs the univariate slice sampler of slice-sampling.h for a batch of
+// customers at once, so that the log-density can be evaluated for all lanes
+// in one vectorized call (see simd.h). `logfn(v, out)` evaluates the lanes of
+// `v` into `out`. The stepping-out and shrinkage loops iterate until all lanes
+// are done; lanes that finish early are masked out, and keep being evaluated
+// at a valid position. Only the first `n` lanes are sampled; the remaining
+// ones are padded with lane 0 and left untouched.
+//
+// Lane `j` draws its random numbers from its own generator `rng[j]`, e.g. the
+// customer's Philox stream (see CustomerStreams in parallel.h), so that the
+// draws of a customer do not depend on the other customers of its batch. This
+// is only used where results are not expected to match R's RNG stream, i.e.
+// in the multi-threaded sweeps. The evaluation
+// budget of `ctl` applies per lane, and `evals` counts all `n` lanes of each
+// call; the doubling procedure is not available in lock-step, and callers fall
+// back to the scalar sampler for it.
+
+template <typename LogFn, typename Rng>
+void slice_sample_batch(LogFn logfn, double* x, int n, int steps, const double* w,
+                        double lower, double upper, Rng* rng, SliceControl* ctl = NULL) {
+  const int W = SIMD_WIDTH;
+  double logy[W], logz[W], L[W], R[W], r0[W], r1[W], xs[W], f[W];
+  long long J[W], K[W], used[W];
+  bool active[W];
+  long long budget = ctl != NULL ? ctl->max_evals : 0;
+  long long evals = 0, exhausted = 0, expansions = 0, shrinks = 0;
+  auto eval = [&](const double* v, double* out) {
+    evals += n;
+    logfn(v, out);
+  };
+  for (int j = n; j < W; j++) x[j] = x[0];
+  eval(x, logy);
+
+  for (int i = 0; i < steps; i++) {
+    for (int j = 0; j < n; j++) {
+      // draw uniformly from [0, y]
+      logz[j] = logy[j] - rng[j].exp_rand();
+      // expand search range
+      double u = rng[j].unif_rand() * w[j];
+      L[j] = x[j] - u;
+      R[j] = x[j] + (w[j]-u);
+      used[j] = 0;
+      // with a budget, at most m steps in total, split at random between both
+      // directions; see slice_sample_cpp
+      if (budget > 0) {
+        long long m = std::max(budget / 2, 1LL);
+        J[j] = static_cast<long long>(m * rng[j].unif_rand());
+        K[j] = m - 1 - J[j];
+      }
+    }
+    for (int j = n; j < W; j++) {
+      L[j] = R[j] = x[j];
+    }
+
+    // step out to the left, and then to the right
+    for (int j = 0; j < W; j++) active[j] = j < n && (budget <= 0 || J[j] > 0);
+    for (bool any = true; any; ) {
+      eval(L, f);
+      any = false;
+      for (int j = 0; j < n; j++) {
+        if (!active[j]) continue;
+        used[j]++;
+        if (L[j] > lower && f[j] > logz[j]) {
+          L[j] = L[j] - w[j];
+          expansions++;
+          active[j] = budget <= 0 || --J[j] > 0;
+          any = any || active[j];
+        } else {
+          active[j] = false;
+        }
+      }
+    }
+    for (int j = 0; j < W; j++) active[j] = j < n && (budget <= 0 || K[j] > 0);
+    for (bool any = true; any; ) {
+      eval(R, f);
+      any = false;
+      for (int j = 0; j < n; j++) {
+        if (!active[j]) continue;
+        used[j]++;
+        if (R[j] < upper && f[j] > logz[j]) {
+          R[j] = R[j] + w[j];
+          expansions++;
+          active[j] = budget <= 0 || --K[j] > 0;
+          any = any || active[j];
+        } else {
+          active[j] = false;
+        }
+      }
+    }
+
+    // sample until draw is within valid range; lanes that run out of budget
+    // keep their current value
+    for (int j = 0; j < W; j++) {
+      r0[j] = std::max(L[j], lower);
+      r1[j] = std::min(R[j], upper);
+      xs[j] = x[j];
+      active[j] = j < n;
+    }
+    int cnt = 0;
+    for (bool any = true; any; ) {
+      any = false;
+      for (int j = 0; j < n; j++) {
+        if (active[j] && (cnt >= 1e4 || (budget > 0 && used[j] >= budget))) {
+          active[j] = false;
+          exhausted++;
+        }
+        if (active[j]) {
+          xs[j] = slice_runif(rng[j], r0[j], r1[j]);
+          any = true;
+        }
+      }
+      if (!any) break;
+      cnt++;
+      eval(xs, f);
+      any = false;
+      for (int j = 0; j < n; j++) {
+        if (!active[j]) continue;
+        used[j]++;
+        if (f[j] > logz[j]) {
+          x[j] = xs[j];
+          logy[j] = f[j];
+          active[j] = false;
+        } else {
+          shrinks++;
+          if (xs[j] < x[j])
+            r0[j] = xs[j];
+          else
+            r1[j] = xs[j];
+          xs[j] = x[j];
+          any = true;
+        }
+      }
+    }
+  }
+
+  if (ctl != NULL) {
+    ctl->evals += evals;
+    ctl->draws += static_cast<long long>(steps) * n;
+    ctl->exhausted += exhausted;
+    ctl->expansions += expansions;
+    ctl->shrinks += shrinks;
+  }
+}
+
+#endif
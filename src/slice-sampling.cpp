@@ -1,153 +1,54 @@
 #include <Rcpp.h>
+#include <algorithm>
+#include <vector>
+#include "slice-sampling.h"
+#include "parallel.h"
+#include "pareto-ggg.h"
+#include "pareto-nbd.h"
+#include "bg-cnbd-k.h"
+#include "progress.h"
 
 using namespace Rcpp;
 
-// slice sampling
-
-// This is a stripped down C++ version of diversitree::mcmc thta only returns
-// the draw from the last step. Drawing from gamma distribution is now 300x
-// faster than compared with diversitree::mcmc.
-
-// The algorithm is described in detail in Neal R.M. 2003. Slice sampling.
-// Annals of Statistics 31:705-767. which describes *why* this algorithm works.
-// The approach differs from normal Metropolis-Hastings algorithms, and from
-// Gibbs samplers, but shares the Gibbs sampler property of every update being
-// accepted.  Nothing is required except the ability to evaluate the function at
-// every point in continuous parameter space.
-
-// Let x0 be the current (possibly multivariate) position in continuous
-// parameter space, and let y0 be the probability at that point.  To update from
-// (x0, y0) -> (x1, y1), we update each of the parameters in turn.  For each
-// parameter
-//
-//   1. Draw a random number 'z' on Uniform(0, y0) -- the new point
-//      must have at least this probability.
-//
-//   2. Find a region (x.l, x.r) that contains x0[i], such that x.l
-//      and x.r are both smaller than z.
-//
-//   3. Randomly draw a new position from (x.l, x.r).  If this
-//      position is greater than z, this is our new position.
-//      Otherwise it becomes a new boundary and we repeat this step
-//      (the point x1 becomes x.l if x.l < x0[i], and x.r otherwise so
-//      that x0[i] is always contained within the interval).
-// Because it is generally more convenient to work with log
-// probabilities, step 1 is modified so that we draw 'z' by taking
-//   y0 - rexp(1)
-// All other steps remain unmodified.
-
-NumericVector slice_sample_cpp(double (*logfn)(NumericVector, NumericVector),
-                        NumericVector params,
-                        NumericVector x0,
-                        int steps = 10,
-                        double w = 1,
-                        double lower = -INFINITY,
-                        double upper = INFINITY) {
-
-  double u, r0, r1, logy, logz, logys;
-  NumericVector x, xs, L, R;
-
-  x = clone(x0);
-  L = clone(x0);
-  R = clone(x0);
-  logy = logfn(x, params);
-
-  for (int i = 0; i < steps; i++) {
-
-    for (int j = 0; j < x0.size(); j++) {
-      // draw uniformly from [0, y]
-      logz = logy - rexp(1)[0];
-
-      // expand search range
-      u = runif(1)[0] * w;
-      L[j] = x[j] - u;
-      R[j] = x[j] + (w-u);
-      while ( L[j] > lower && logfn(L, params) > logz )
-        L[j] = L[j] - w;
-      while ( R[j] < upper && logfn(R, params) > logz )
-        R[j] = R[j] + w;
-
-      // sample until draw is within valid range
-      r0 = std::max(L[j], lower);
-      r1 = std::min(R[j], upper);
-
-      xs = clone(x);
-      int cnt = 0;
-      do {
-        cnt++;
-        xs[j] = runif(1, r0, r1)[0];
-        logys = logfn(xs, params);
-        if ( logys > logz )
-          break;
-        if ( xs[j] < x[j] )
-          r0 = xs[j];
-        else
-          r1 = xs[j];
-      } while (cnt<1e4);
-      if (cnt==1e4) ::Rf_error("slice_sample_cpp loop did not finish");
-
-      x = clone(xs);
-      logy = logys;
-    }
-  }
-
-  return x;
-}
-
 // // draw from gamma distribution (for test purposes)
 //
-// double post_gamma(NumericVector x, NumericVector params) {
-//   double alpha = params[0];
-//   double beta = params[1];
-//   return (alpha - 1) * log(x[0]) - beta * x[0];
+// double post_gamma(double x, double alpha, double beta) {
+//   return (alpha - 1) * log(x) - beta * x;
 // }
 //
 // // [[Rcpp::export]]
-// NumericVector slice_sample_gamma(double alpha, double beta, double lower, double upper) {
-//   NumericVector params = NumericVector::create(alpha, beta);
-//   NumericVector x0 = NumericVector::create(alpha/beta);
+// double slice_sample_gamma(double alpha, double beta, double lower, double upper) {
 //   double steps = 10;
 //   double w = 3 * sqrt(alpha) / beta; // approx size of (q95-q05)
-//   return slice_sample_cpp(post_gamma, params, x0, steps, w, lower, upper);
+//   auto logfn = [&](double x) { return post_gamma(x, alpha, beta); };
+//   return slice_sample_cpp(logfn, alpha/beta, steps, w, lower, upper);
 // }
 //
 // // draw from multivariate normal distribution (for test purposes)
 //
-// double post_mvnorm(NumericVector x, NumericVector sigma) {
+// double post_mvnorm(const std::array<double, 2>& x, NumericVector sigma) {
 //   return -log(2*3.141593) -0.5 * log(sigma[0]*sigma[3]-sigma[1]*sigma[2]) -0.5 * (1/(sigma[0]*sigma[3]-sigma[1]*sigma[2])) *
 //     (x[0]*x[0]*sigma[3] - x[0]*x[1]*sigma[2] - x[0]*x[1]*sigma[1] + x[1]*x[1]*sigma[0]);
 // }
 //
 // // [[Rcpp::export]]
 // NumericVector slice_sample_mvnorm(NumericVector sigma) {
-//   NumericVector x0 = NumericVector::create(0.2, 0.3);
+//   std::array<double, 2> x0 = {{0.2, 0.3}};
 //   double steps = 20;
-//   return slice_sample_cpp(post_mvnorm, sigma, x0, steps);
+//   auto logfn = [&](const std::array<double, 2>& x) { return post_mvnorm(x, sigma); };
+//   std::array<double, 2> x = slice_sample_cpp(logfn, x0, steps);
+//   return NumericVector::create(x[0], x[1]);
 // }
 
 // estimate parameters of gamma distribution
 
-double post_gamma_parameters(NumericVector log_data, NumericVector params) {
-  double shape = exp(log_data[0]);
-  double rate = exp(log_data[1]);
-  double len_x = params[0];
-  double sum_x = params[1];
-  double sum_log_x = params[2];
-  double hyper1 = params[3];
-  double hyper2 = params[4];
-  double hyper3 = params[5];
-  double hyper4 = params[6];
-  return len_x * (shape * log(rate) - lgamma(shape)) + (shape-1) * sum_log_x - rate * sum_x +
-    (hyper1 - 1) * log(shape) - (shape * hyper2) +
-    (hyper3 - 1) * log(rate) - (rate * hyper4);
-}
-
 // [[Rcpp::export]]
 NumericVector slice_sample_gamma_parameters(NumericVector data, NumericVector init,
                                             NumericVector hyper, double steps = 20, double w = 1) {
-  NumericVector params = NumericVector::create(data.size(), sum(data), sum(log(data)),
-                                                hyper[0], hyper[1], hyper[2], hyper[3]);
-  return exp(slice_sample_cpp(post_gamma_parameters, params, log(init), steps, w, -INFINITY, INFINITY));
+  RRng rng;
+  std::array<double, 2> draw = slice_sample_gamma_parameters_cpp(data.begin(), data.size(), init[0], init[1],
+                                                                 hyper.begin(), steps, w, rng);
+  return NumericVector::create(draw[0], draw[1]);
 }
 
 /*** R
@@ -225,64 +126,51 @@ NumericVector slice_sample_gamma_parameters(NumericVector data, NumericVector in
 // ********* Pareto / NBD **********
 
 
-// draw of individual-level posterior for Pareto/NBD (Ma/Liu)
-
-double post_lambda_ma_liu(NumericVector data, NumericVector params) {
-  double lambda_ = data[0];
-  double x       = params[0];
-  double tx      = params[1];
-  double Tcal    = params[2];
-//  double lambda = params[3];
-  double mu      = params[4];
-  double r       = params[5];
-  double alpha   = params[6];
-//  double s       = params[7];
-//  double beta    = params[8];
-  if ( log(mu+lambda_) - log(mu) < 1e-10 ) {
-    return -INFINITY; // avoid numeric underflow
-  } else {
-    return (r-1) * log(lambda_) - (lambda_*alpha) +
-      x * log(lambda_) - log(lambda_+mu) +
-      log(mu*exp(-tx*(lambda_+mu))+lambda_*exp(-Tcal*(lambda_+mu)));
-  }
-}
+// draw of individual-level posterior for Pareto/NBD (Ma/Liu); the kernels live
+// in pareto-nbd.h, as they are shared with the MCMC driver
 
-double post_mu_ma_liu(NumericVector data, NumericVector params) {
-  double mu_    = data[0];
-  double x      = params[0];
-  double tx     = params[1];
-  double Tcal   = params[2];
-  double lambda = params[3];
-//  double mu     = params[4];
-//  double r      = params[5];
-//  double alpha  = params[6];
-  double s      = params[7];
-  double beta   = params[8];
-  if ( log(lambda+mu_) - log(lambda) < 1e-10 ) {
-    return -INFINITY; // avoid numeric underflow
+// sweep over customers [begin, end); the data is passed as raw pointers, so that
+// the sweep can run on a worker thread without touching any R objects
+template <typename Rng>
+void slice_sample_ma_liu_range(bool draw_lambda, int begin, int end, Rng& rng,
+                               const double* x, const double* tx, const double* Tcal,
+                               const double* lambda, const double* mu,
+                               double r, double alpha, double s, double beta, double* out) {
+  if (draw_lambda) {
+    for (int i=begin; i<end; i++) {
+      out[i] = pnbd_draw_lambda_ma_liu(x[i], tx[i], Tcal[i], lambda[i], mu[i], r, alpha, rng);
+    }
   } else {
-    return (s-1) * log(mu_) - (mu_*beta) +
-      x * log(lambda) - log(lambda+mu_) +
-      log(mu_*exp(-tx*(lambda+mu_))+lambda*exp(-Tcal*(lambda+mu_)));
+    for (int i=begin; i<end; i++) {
+      out[i] = pnbd_draw_mu_ma_liu(x[i], tx[i], Tcal[i], lambda[i], mu[i], s, beta, rng);
+    }
   }
 }
 
-
 // [[Rcpp::export]]
 NumericVector slice_sample_ma_liu(String what,
                                   NumericVector x, NumericVector tx, NumericVector Tcal,
                                   NumericVector lambda, NumericVector mu,
-                                  double r, double alpha, double s, double beta) {
+                                  double r, double alpha, double s, double beta,
+                                  int threads = 1) {
   int N = x.size();
   NumericVector out(N);
-  for (int i=0; i<N; i++) {
-    // Rcpp::Rcout << i << " x:" << x[i] << " tx:" << tx[i] << " Tcal:" << Tcal[i] << " lambda:" << lambda[i] << " mu:" << mu[i] << " r:" << r << " alpha:" << alpha << " s:" << s << " beta:" << beta << " - " << std::endl;
-    NumericVector params = NumericVector::create(x[i], tx[i], Tcal[i], lambda[i], mu[i], r, alpha, s, beta);
-    if (what == "lambda") {
-      out[i] = slice_sample_cpp(post_lambda_ma_liu, params, NumericVector::create(lambda[i]), 3, 3 * sqrt(r) / alpha, 1e-5, 1e+5)[0];
-    } else if (what == "mu") {
-      out[i] = slice_sample_cpp(post_mu_ma_liu, params, NumericVector::create(mu[i]), 6, 3 * sqrt(s) / beta, 1e-5, 1e+5)[0];
-    }
+  if (what != "lambda" && what != "mu") return out;
+  bool draw_lambda = (what == "lambda");
+  const double *px = x.begin(), *ptx = tx.begin(), *pTcal = Tcal.begin();
+  const double *plambda = lambda.begin(), *pmu = mu.begin();
+  double* pout = out.begin();
+  if (threads <= 1) {
+    RRng rng;
+    interruptible_chunks(N, [&](int begin, int end) {
+      slice_sample_ma_liu_range(draw_lambda, begin, end, rng, px, ptx, pTcal, plambda, pmu, r, alpha, s, beta, pout);
+    });
+  } else {
+    parallel_streams(N, threads, 1, [&](CustomerStreams& streams, int begin, int end) {
+      for (int i=begin; i<end; i++)
+        slice_sample_ma_liu_range(draw_lambda, i, i+1, streams.at(i), px, ptx, pTcal, plambda, pmu,
+                                  r, alpha, s, beta, pout);
+    });
   }
   return out;
 }
@@ -293,148 +181,192 @@ NumericVector slice_sample_ma_liu(String what,
 // ********* Pareto / GGG **********
 
 
-// draw of individual-level posterior for Pareto/GGG
-
-double pggg_palive_integrand(double x, double params[6]) {
-  double tx = params[1];
-  double k = params[3];
-  double lambda = params[4];
-  double mu = params[5];
-  // call pgamma with lower.tail=FALSE and log.p=FALSE; note that 3rd parameter is scale and not rate;
-  return (::Rf_pgamma(x-tx, k, 1/(k*lambda), 0, 0) * exp(-mu*x));
-}
-
-double simpson38(double (*fn)(double, double[6]), double a, double b, double fn_params[6]) {
-  // http://en.wikipedia.org/wiki/Simpson%27s_rule#Simpson.27s_3.2F8_rule_.28for_n_intervals.29
-  double n = 12.0;
-  double integral = (3.0/8.0) * ((b-a)/n) *
-    (fn(a, fn_params) +
-    3 * fn(a+(1/n)*(b-a), fn_params) +
-    3 * fn(a+(2/n)*(b-a), fn_params) +
-    2 * fn(a+(3/n)*(b-a), fn_params) +
-    3 * fn(a+(4/n)*(b-a), fn_params) +
-    3 * fn(a+(5/n)*(b-a), fn_params) +
-    2 * fn(a+(6/n)*(b-a), fn_params) +
-    3 * fn(a+(7/n)*(b-a), fn_params) +
-    3 * fn(a+(8/n)*(b-a), fn_params) +
-    2 * fn(a+(9/n)*(b-a), fn_params) +
-    3 * fn(a+(10/n)*(b-a), fn_params) +
-    3 * fn(a+(11/n)*(b-a), fn_params) +
-    fn(b, fn_params));
-  return(integral);
-}
+// draw of individual-level posterior for Pareto/GGG; the kernels live in
+// pareto-ggg.h, as they are shared with the MCMC driver
 
+// `rule` is one of "simpson", "gauss-legendre" or "adaptive"; see
+// pggg_palive_rule in pareto-ggg.h
 // [[Rcpp::export]]
 NumericVector pggg_palive(NumericVector x, NumericVector tx, NumericVector Tcal,
-                           NumericVector k, NumericVector lambda, NumericVector mu) {
+                           NumericVector k, NumericVector lambda, NumericVector mu,
+                           std::string rule = "simpson", int threads = 1) {
+  pggg_palive_rule palive_rule = pggg_palive_rule_from_string(rule);
   int N = x.size();
   NumericVector out(N);
-  for (int i=0; i<N; i++) {
-    // calc numerator
-    double one_minus_F = ::Rf_pgamma(Tcal[i]-tx[i], k[i], 1/(k[i]*lambda[i]), 0, 0);
-    double numer = one_minus_F * exp(-mu[i]*Tcal[i]);
-    // calc denominator by integrating from tx to Tcal
-    // - we integrate numerically via Simpson3/8 rule (calling Rdqags crashed under Unix)
-    double fn_params[6] = {x[i], tx[i], Tcal[i], k[i], lambda[i], mu[i]};
-    double integral = simpson38(pggg_palive_integrand, tx[i], Tcal[i], fn_params);
-    double denom = numer + mu[i] * integral;
-    out[i] = (numer/denom);
+  const double *px = x.begin(), *ptx = tx.begin(), *pTcal = Tcal.begin();
+  const double *pk = k.begin(), *plambda = lambda.begin(), *pmu = mu.begin();
+  double* pout = out.begin();
+  auto sweep = [&](int begin, int end) {
+    for (int i=begin; i<end; i++) {
+      pout[i] = pggg_palive_cpp(px[i], ptx[i], pTcal[i], pk[i], plambda[i], pmu[i], palive_rule);
+    }
+  };
+  if (threads <= 1) {
+    interruptible_chunks(N, sweep);
+  } else {
+    parallel_ranges(N, threads, [&](int, int begin, int end) { sweep(begin, end); });
   }
   return(out);
 }
 
 
-double pggg_post_tau(NumericVector data, NumericVector params) {
-  double tau_    = data[0];
-//  double x      = params[0];
-//  double tx     = params[1];
-//  double Tcal   = params[2];
-//  double litt   = params[3];
-  double k      = params[4];
-  double lambda = params[5];
-  double mu     = params[6];
-//  double tau    = params[7];
-//  double t      = params[8];
-//  double gamma  = params[9];
-//  double r      = params[10];
-//  double alpha  = params[11];
-//  double s      = params[12];
-//  double beta   = params[13];
-
-  return(-mu*tau_ + ::Rf_pgamma(tau_, k, 1/(k*lambda), 0, 1));
-}
-
-
-double pggg_post_k(NumericVector data, NumericVector params) {
-  double k_     = data[0];
-  double x      = params[0];
-  double tx     = params[1];
-  double Tcal   = params[2];
-  double litt   = params[3];
-//  double k      = params[4];
-  double lambda = params[5];
-//  double mu     = params[6];
-  double tau    = params[7];
-  double t      = params[8];
-  double gamma  = params[9];
-//  double r      = params[10];
-//  double alpha  = params[11];
-//  double s      = params[12];
-//  double beta   = params[13];
-
-  double log_one_minus_F = ::Rf_pgamma(std::min(Tcal, tau) - tx, k_, 1/(k_*lambda), 0, 1);
-  return (t-1) * log(k_) - (k_*gamma) +
-    k_ * x * log(k_*lambda) - x * lgamma(k_) - k_ * lambda * tx + (k_-1) * litt +
-    log_one_minus_F;
+// log of the upper tail of the gamma distribution, as used by the kernels;
+// equals pgamma(x, shape, lower.tail = FALSE, log.p = TRUE)
+// [[Rcpp::export]]
+NumericVector pggg_log_upper_gamma(NumericVector x, double shape) {
+  LogUpperGamma log_q(shape);
+  int N = x.size();
+  NumericVector out(N);
+  for (int i=0; i<N; i++) out[i] = log_q(x[i]);
+  return out;
 }
 
-double pggg_post_lambda(NumericVector data, NumericVector params) {
-  double lambda_ = data[0];
-  double x       = params[0];
-  double tx      = params[1];
-  double Tcal    = params[2];
-//  double litt    = params[3];
-  double k       = params[4];
-//  double lambda  = params[5];
-//  double mu      = params[6];
-  double tau     = params[7];
-//  double t       = params[8];
-//  double gamma   = params[9];
-  double r       = params[10];
-  double alpha   = params[11];
-//  double s       = params[12];
-//  double beta    = params[13];
-
-  double log_one_minus_F = ::Rf_pgamma(std::min(Tcal, tau) - tx, k, 1/(k*lambda_), 0, 1);
-  return (r-1) * log(lambda_) - (lambda_*alpha) +
-    k * x * log(lambda_) - k * lambda_ * tx +
-    log_one_minus_F;
+enum pggg_param { PGGG_K, PGGG_LAMBDA, PGGG_TAU };
+
+// sweep over customers [begin, end); see slice_sample_ma_liu_range
+template <typename Rng>
+void pggg_slice_sample_range(pggg_param what, int begin, int end, Rng& rng,
+                             const double* x, const double* tx, const double* Tcal, const double* litt,
+                             const double* k, const double* lambda, const double* mu, const double* tau,
+                             double t, double gamma, double r, double alpha, double* out) {
+  if (what == PGGG_K) {
+    for (int i=begin; i<end; i++) {
+      out[i] = pggg_draw_k(x[i], tx[i], Tcal[i], litt[i], k[i], lambda[i], tau[i], t, gamma, rng);
+    }
+  } else if (what == PGGG_LAMBDA) {
+    for (int i=begin; i<end; i++) {
+      out[i] = pggg_draw_lambda(x[i], tx[i], Tcal[i], k[i], lambda[i], tau[i], r, alpha, rng);
+    }
+  } else if (what == PGGG_TAU) {
+    for (int i=begin; i<end; i++) {
+      out[i] = pggg_draw_tau(tx[i], Tcal[i], k[i], lambda[i], mu[i], rng);
+    }
+  }
 }
 
-
 // [[Rcpp::export]]
 NumericVector pggg_slice_sample(String what,
                                   NumericVector x, NumericVector tx, NumericVector Tcal, NumericVector litt,
                                   NumericVector k, NumericVector lambda, NumericVector mu, NumericVector tau,
-                                  double t, double gamma, double r, double alpha, double s, double beta) {
+                                  double t, double gamma, double r, double alpha, double s, double beta,
+                                  int threads = 1) {
+  // the shape and rate of mu are part of the signature, but not needed by the
+  // kernels; they are not commented out, as Rcpp's attributes need the names
+  (void) s;
+  (void) beta;
   int N = x.size();
   NumericVector out(N);
+  pggg_param param;
+  if (what == "k") {
+    param = PGGG_K;
+  } else if (what == "lambda") {
+    param = PGGG_LAMBDA;
+  } else if (what == "tau") {
+    param = PGGG_TAU;
+  } else {
+    return out;
+  }
+  const double *px = x.begin(), *ptx = tx.begin(), *pTcal = Tcal.begin(), *plitt = litt.begin();
+  const double *pk = k.begin(), *plambda = lambda.begin(), *pmu = mu.begin(), *ptau = tau.begin();
+  double* pout = out.begin();
+  // the kernels only call lgamma and LogUpperGamma, which work on plain doubles,
+  // and are thus safe to evaluate on worker threads
+  if (threads <= 1) {
+    RRng rng;
+    interruptible_chunks(N, [&](int begin, int end) {
+      pggg_slice_sample_range(param, begin, end, rng, px, ptx, pTcal, plitt, pk, plambda, pmu, ptau,
+                              t, gamma, r, alpha, pout);
+    });
+  } else {
+    parallel_streams(N, threads, 1, [&](CustomerStreams& streams, int begin, int end) {
+      for (int i=begin; i<end; i++)
+        pggg_slice_sample_range(param, i, i+1, streams.at(i), px, ptx, pTcal, plitt, pk, plambda, pmu, ptau,
+                                t, gamma, r, alpha, pout);
+    });
+  }
+  return out;
+}
 
-  for (int i=0; i<N; i++) {
-    NumericVector params = NumericVector::create(
-                              x[i], tx[i], Tcal[i], litt[i],
-                              k[i], lambda[i], mu[i], tau[i],
-                              t, gamma, r, alpha, s, beta);
-    //Rcpp::Rcout << i << " - " << x[i] << " - " << tx[i] << " - " << Tcal[i] << " - " << litt[i] << " - " << k[i] << " - " << lambda[i] << " - " << mu[i] << " - " << tau[i] << " - " << t << " - " << gamma << " - " << r << " - " << alpha << " - " << s << " - " << beta << " - " << std::endl;
-    if (what == "k") {
-      out[i] = slice_sample_cpp(pggg_post_k, params, NumericVector::create(k[i]), 3, 3 * sqrt(t) / gamma, 1e-1, 1e+3)[0];
-    } else if (what == "lambda") {
-      out[i] = slice_sample_cpp(pggg_post_lambda, params, NumericVector::create(lambda[i]), 3, 3 * sqrt(r) / alpha, 1e-30, 1e+5)[0];
-    } else if (what == "tau") {
-      double tau_init = std::min(Tcal[i]-tx[i], ::Rf_rgamma(k[i], 1/(k[i]*lambda[i]))) / 2;
-      out[i] = tx[i] + slice_sample_cpp(pggg_post_tau, params, NumericVector::create(tau_init), 6, (Tcal[i]-tx[i])/2, 0, Tcal[i]-tx[i])[0];
+
+// evaluates the vectorized `log` or `exp` (see simd.h), or the batched
+// log-posterior `pnbd_lambda`, `pnbd_mu`, `pggg_k` or `pggg_lambda` of the
+// lock-step samplers at `v`, with `prior` holding the cohort-level parameters
+// (r, alpha), (s, beta), resp. (t, gamma); returns a [value x 2] matrix of the
+// batched results and of their scalar counterparts, i.e. the C library, resp.
+// the post_* kernels of the single-customer samplers. With `avx2 = FALSE` the
+// portable kernels are used, also on AVX2 capable CPUs (for test purposes).
+// [[Rcpp::export]]
+NumericMatrix simd_compare_cpp(String what, NumericVector v, NumericVector x, NumericVector tx,
+                               NumericVector Tcal, NumericVector litt, NumericVector k, NumericVector lambda,
+                               NumericVector mu, NumericVector tau, NumericVector prior, bool avx2 = true) {
+  const int W = SIMD_WIDTH;
+  int N = v.size();
+  bool per_customer = what != "log" && what != "exp";
+  if (per_customer && (x.size() != N || tx.size() != N || Tcal.size() != N || litt.size() != N ||
+                       k.size() != N || lambda.size() != N || mu.size() != N || tau.size() != N))
+    Rcpp::stop("vectors need to be of same length");
+  if (per_customer && prior.size() != 2) Rcpp::stop("`prior` needs to be of length 2");
+  if (per_customer && what != "pnbd_lambda" && what != "pnbd_mu" && what != "pggg_k" && what != "pggg_lambda")
+    Rcpp::stop("unknown `what`");
+  double p1 = per_customer ? prior[0] : 0, p2 = per_customer ? prior[1] : 0;
+  NumericMatrix out(N, 2);
+  bool avx2_before = simd_set_avx2(avx2);
+  for (int b = 0; b < N; b += W) {
+    // pad the last batch with its first lane
+    double vs[W], xs[W], txs[W], Tcals[W], dts[W], litts[W], ks[W], lambdas[W], mus[W], aux[W], res[W];
+    LogUpperGamma log_q[W];
+    for (int j = 0; j < W; j++) {
+      int i = b + j < N ? b + j : b;
+      vs[j] = v[i];
+      if (!per_customer) continue;
+      xs[j] = x[i];
+      txs[j] = tx[i];
+      Tcals[j] = Tcal[i];
+      dts[j] = std::min(Tcal[i], tau[i]) - tx[i];
+      litts[j] = litt[i];
+      ks[j] = k[i];
+      lambdas[j] = lambda[i];
+      mus[j] = mu[i];
+      log_q[j] = LogUpperGamma(k[i]);
+    }
+    if (what == "log") {
+      simd_log(vs, res);
+    } else if (what == "exp") {
+      simd_exp(vs, res);
+    } else if (what == "pnbd_lambda") {
+      simd_log(mus, aux);
+      post_lambda_ma_liu_batch(vs, xs, txs, Tcals, mus, aux, p1, p2, res);
+    } else if (what == "pnbd_mu") {
+      simd_log(lambdas, aux);
+      post_mu_ma_liu_batch(vs, xs, txs, Tcals, lambdas, aux, p1, p2, res);
+    } else if (what == "pggg_k") {
+      pggg_post_k_batch(vs, xs, txs, dts, litts, lambdas, p1, p2, res);
+    } else {
+      pggg_post_lambda_batch(vs, xs, txs, dts, ks, log_q, p1, p2, res);
+    }
+    for (int j = 0; j < W && b + j < N; j++) {
+      int i = b + j;
+      double scalar;
+      if (what == "log") {
+        scalar = std::log(v[i]);
+      } else if (what == "exp") {
+        scalar = std::exp(v[i]);
+      } else if (what == "pnbd_lambda") {
+        scalar = post_lambda_ma_liu(v[i], x[i], tx[i], Tcal[i], mu[i], p1, p2);
+      } else if (what == "pnbd_mu") {
+        scalar = post_mu_ma_liu(v[i], x[i], tx[i], Tcal[i], lambda[i], p1, p2);
+      } else if (what == "pggg_k") {
+        scalar = pggg_post_k(v[i], x[i], tx[i], Tcal[i], litt[i], lambda[i], tau[i], p1, p2);
+      } else {
+        scalar = pggg_post_lambda(v[i], x[i], tx[i], Tcal[i], k[i], tau[i], p1, p2, log_q[j]);
+      }
+      out(i, 0) = res[j];
+      out(i, 1) = scalar;
     }
   }
+  bool used_avx2 = simd_avx2();
+  simd_set_avx2(avx2_before);
+  out.attr("avx2") = used_avx2;
   return out;
 }
 
@@ -513,28 +445,9 @@ double xbgcnbd_pmf_cpp(NumericVector params, double t, int x, bool dropout_at_ze
   double alpha = params[2];
   double a     = params[3];
   double b     = params[4];
-  double survivals = x - 1;
-  if (dropout_at_zero) survivals = survivals + 1;
-  double P1 = exp(lgamma(b+survivals+1)+lgamma(a+b)-lgamma(b)-lgamma(a+b+survivals+1));
-  double P2a = 0;
-  for (int i = k*x; i <= k*x+k-1; i++) {
-    P2a += exp(lgamma(r+i) + r*log(alpha) + i*log(t) - lgamma(i+1) - lgamma(r) - (r+i)*log(alpha+t));
-  }
-  double P2b;
-  if ((dropout_at_zero==FALSE) & (x==0)) {
-    P2b = 0;
-  } else {
-    P2b = a / (b+survivals);
-    if (x>0) {
-      double cmf = 0;
-      for (int i = 0; i <= k*x-1; i++) {
-        cmf += exp(lgamma(r+i) + r*log(alpha) + i*log(t) - lgamma(i+1) - lgamma(r) - (r+i)*log(alpha+t));
-      }
-      P2b = P2b * (1-cmf);
-    }
-  }
-  double res = P1 * (P2a + P2b);
-  return res;
+  XbgcnbdPmfWalker pmf(k, r, alpha, a, b, t, dropout_at_zero);
+  for (int i = 0; i < x; i++) pmf.next();
+  return pmf.next();
 }
 
 // [[Rcpp::export]]
@@ -546,17 +459,21 @@ NumericVector xbgcnbd_exp_cpp(NumericVector params, NumericVector t, bool dropou
   int k        = params[0];
   double r     = params[1];
   double alpha = params[2];
+  double a     = params[3];
+  double b     = params[4];
   int stop;
   double add;
   for (int j=0; j<N; j++) {
+    if (j % InterruptPoll::every == 0) Rcpp::checkUserInterrupt();
     stop = k * R::qnbinom(0.9999, r, alpha/(alpha+t[j]), TRUE, FALSE);
-    //Rcpp::Rcout << " stop:" << stop << std::endl;
     if (stop < 100) stop = 100;
+    // walk the PMF once, instead of evaluating it from scratch for each i
+    XbgcnbdPmfWalker pmf(k, r, alpha, a, b, t[j], dropout_at_zero);
+    pmf.next();
     for (int i=1; i<stop; i++) {
-      add = i * xbgcnbd_pmf_cpp(params, t[j], i, dropout_at_zero);
+      add = i * pmf.next();
       res[j] += add;
       if ((add < 1e-8) & (i >= 100)) {
-        //Rcpp::Rcout << " break:" << i << std::endl;
         break;
       }
     }
@@ -565,6 +482,39 @@ NumericVector xbgcnbd_exp_cpp(NumericVector params, NumericVector t, bool dropou
 }
 
 
+// returns the matrix of P(X(t) = x) for all combinations of `x` (rows) and
+// `t` (columns); the PMF is walked once per t, up to max(x), and the columns
+// are computed on `threads` threads
+// [[Rcpp::export]]
+NumericMatrix xbgcnbd_pmf_grid_cpp(NumericVector params, NumericVector t, IntegerVector x,
+                                   bool dropout_at_zero = false, int threads = 1) {
+  if (params.size() != 5) ::Rf_error("params needs to be of size 5 with (k, r, alpha, a, b)");
+  int k        = params[0];
+  double r     = params[1];
+  double alpha = params[2];
+  double a     = params[3];
+  double b     = params[4];
+  int nt = t.size(), nx = x.size();
+  int max_x = 0;
+  for (int i=0; i<nx; i++) max_x = std::max(max_x, x[i]);
+  NumericMatrix res(nx, nt);
+  const double* pt = t.begin();
+  const int* px = x.begin();
+  double* pres = res.begin();
+  parallel_ranges(nt, threads, [&](int, int begin, int end) {
+    std::vector<double> pmf(max_x + 1);
+    for (int j=begin; j<end; j++) {
+      XbgcnbdPmfWalker walker(k, r, alpha, a, b, pt[j], dropout_at_zero);
+      for (int i=0; i<=max_x; i++) pmf[i] = walker.next();
+      for (int i=0; i<nx; i++) {
+        pres[i + static_cast<R_xlen_t>(nx) * j] = (px[i] >= 0) ? pmf[px[i]] : 0;
+      }
+    }
+  });
+  return res;
+}
+
+
 /*** R
   params <- c(3, 0.5, 2, 0.3, 0.6)
   stopifnot(round(xbgcnbd_ll_cpp(params, c(3,4), c(12,12), c(14,14), c(3,3)), 5) == c( -10.42500,-12.22396))
@@ -0,0 +1,452 @@
+#ifndef BTYDPLUS_SLICE_SAMPLING_H
+#define BTYDPLUS_SLICE_SAMPLING_H
+
+#include <Rcpp.h>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "rng.h"
+#include "parallel.h"
+#include "simd.h"
+
+// slice sampling
+
+// This is a stripped down C++ version of diversitree::mcmc thta only returns
+// the draw from the last step. Drawing from gamma distribution is now 300x
+// faster than compared with diversitree::mcmc.
+
+// The algorithm is described in detail in Neal R.M. 2003. Slice sampling.
+// Annals of Statistics 31:705-767. which describes *why* this algorithm works.
+// The approach differs from normal Metropolis-Hastings algorithms, and from
+// Gibbs samplers, but shares the Gibbs sampler property of every update being
+// accepted.  Nothing is required except the ability to evaluate the function at
+// every point in continuous parameter space.
+
+// Let x0 be the current (possibly multivariate) position in continuous
+// parameter space, and let y0 be the probability at that point.  To update from
+// (x0, y0) -> (x1, y1), we update each of the parameters in turn.  For each
+// parameter
+//
+//   1. Draw a random number 'z' on Uniform(0, y0) -- the new point
+//      must have at least this probability.
+//
+//   2. Find a region (x.l, x.r) that contains x0[i], such that x.l
+//      and x.r are both smaller than z.
+//
+//   3. Randomly draw a new position from (x.l, x.r).  If this
+//      position is greater than z, this is our new position.
+//      Otherwise it becomes a new boundary and we repeat this step
+//      (the point x1 becomes x.l if x.l < x0[i], and x.r otherwise so
+//      that x0[i] is always contained within the interval).
+// Because it is generally more convenient to work with log
+// probabilities, step 1 is modified so that we draw 'z' by taking
+//   y0 - rexp(1)
+// All other steps remain unmodified.
+
+// The sampler works on a fixed-size std::array, which lives on the stack, and
+// takes the log-density as a callable (functor or lambda), so that it can be
+// inlined. No R objects are allocated, which matters as the sampler is called
+// once per customer and parameter in each MCMC step. Random numbers are taken
+// from `rng` (see rng.h); with RRng the draws are identical to the previous
+// NumericVector based implementation.
+
+// The initial interval is either expanded by stepping out in steps of `w`, or
+// by Neal's doubling procedure (section 4.2), which needs far fewer
+// evaluations when `w` underestimates the width of the slice by orders of
+// magnitude; the doubled interval requires an acceptance test for the draw,
+// to retain the target distribution.
+enum slice_method { SLICE_STEPPING_OUT, SLICE_DOUBLING };
+
+inline slice_method slice_method_from_string(const std::string& method) {
+  if (method == "stepping-out") return SLICE_STEPPING_OUT;
+  if (method == "doubling") return SLICE_DOUBLING;
+  throw std::invalid_argument("unknown slice sampling method '" + method + "'");
+}
+
+// options and metrics of the slice sampler
+//
+// `max_evals` bounds the number of log-density evaluations per update of a
+// coordinate, with 0 for no bound. Half of it is available for expanding the
+// interval, via Neal's randomized limit on the number of steps (section 4.1)
+// resp. the number of doublings (at most `max_doublings`), so that the sampler
+// still leaves the target invariant. If the shrinkage does not find a point
+// within the remaining budget, the coordinate keeps its current value, rather
+// than aborting the chain. Without a bound, the shrinkage gives up after 1e4
+// iterations. `evals`, `draws` and `exhausted` accumulate the number of
+// evaluations, of coordinate updates, and of updates that ran out of budget;
+// `expansions` the number of steps resp. doublings of the interval, and
+// `shrinks` the number of draws outside the slice, that shrank the interval.
+struct SliceControl {
+  slice_method method;
+  long long max_evals;
+  int max_doublings;
+  long long evals, draws, exhausted, expansions, shrinks;
+
+  explicit SliceControl(slice_method method_ = SLICE_STEPPING_OUT, long long max_evals_ = 0,
+                        int max_doublings_ = 10)
+    : method(method_), max_evals(max_evals_), max_doublings(max_doublings_),
+      evals(0), draws(0), exhausted(0), expansions(0), shrinks(0) {}
+
+  // same options, with metrics set to zero, e.g. for use on a worker thread
+  inline SliceControl options() const { return SliceControl(method, max_evals, max_doublings); }
+};
+
+// uniform draw on (r0, r1); consumes the RNG exactly like Rcpp's runif(1, r0, r1)
+template <typename Rng>
+inline double slice_runif(Rng& rng, double r0, double r1) {
+  if (r0 == r1) return r0;
+  return r0 + (r1 - r0) * rng.unif_rand();
+}
+
+// acceptance test for a draw `x1` from the interval (l, r), that was found by
+// doubling from `x0` (Neal 2003, fig. 6); `fn` evaluates the log-density along
+// the coordinate, and `within_budget(n)` returns whether `n` more evaluations
+// are within the evaluation budget of the update; the draw is rejected if the
+// test would exceed it
+template <typename Fn, typename Budget>
+inline bool slice_doubling_accept(Fn& fn, double x0, double x1, double l, double r, double w, double logz,
+                                  Budget within_budget) {
+  bool differ = false;
+  while (r - l > 1.1 * w) {
+    double m = (l + r) / 2;
+    if ((x0 < m) != (x1 < m)) differ = true;
+    if (x1 < m)
+      r = m;
+    else
+      l = m;
+    if (differ) {
+      if (!within_budget(2)) return false;
+      if (logz >= fn(l) && logz >= fn(r)) return false;
+    }
+  }
+  return true;
+}
+
+template <std::size_t D, typename LogFn, typename Rng>
+std::array<double, D> slice_sample_cpp(LogFn logfn,
+                                       const std::array<double, D>& x0,
+                                       int steps,
+                                       double w,
+                                       double lower,
+                                       double upper,
+                                       Rng& rng,
+                                       SliceControl* ctl = NULL) {
+
+  double u, r0, r1, logy, logz, logys = 0;
+  long long evals = 0, exhausted = 0, expansions = 0, shrinks = 0;
+  bool doubling = ctl != NULL && ctl->method == SLICE_DOUBLING;
+  long long budget = ctl != NULL ? ctl->max_evals : 0;
+  auto f = [&](const std::array<double, D>& v) { evals++; return logfn(v); };
+  // note: L and R are initialized once, and keep their values across
+  // coordinates and steps
+  std::array<double, D> x = x0, L = x0, R = x0, xs, xj;
+  logy = f(x);
+
+  for (int i = 0; i < steps; i++) {
+
+    for (std::size_t j = 0; j < D; j++) {
+      long long start = evals;
+      auto within_budget = [&](long long n) { return budget <= 0 || evals - start + n <= budget; };
+      auto out_of_budget = [&]() { return !within_budget(1); };
+      // draw uniformly from [0, y]
+      logz = logy - rng.exp_rand();
+
+      // expand search range
+      u = rng.unif_rand() * w;
+      L[j] = x[j] - u;
+      R[j] = x[j] + (w-u);
+      bool accepted = false;
+      int cnt = 0;
+
+      if (doubling) {
+        // log-density along coordinate j; zero density outside of [lower, upper]
+        auto fj = [&](double v) -> double {
+          if (v < lower || v > upper) return -INFINITY;
+          xj = x;
+          xj[j] = v;
+          return f(xj);
+        };
+        long long K = ctl->max_doublings;
+        if (budget > 0) K = std::min(K, std::max(budget / 2 - 2, 0LL));
+        double l = L[j], r = R[j], fl = fj(l), fr = fj(r);
+        for (; K > 0 && (fl > logz || fr > logz); K--) {
+          double d = r - l;
+          expansions++;
+          if (rng.unif_rand() < 0.5) {
+            l = l - d;
+            fl = fj(l);
+          } else {
+            r = r + d;
+            fr = fj(r);
+          }
+        }
+        // sample until draw is within the slice, and passes the acceptance test
+        r0 = l;
+        r1 = r;
+        while (cnt < 1e4 && !out_of_budget()) {
+          cnt++;
+          double v = slice_runif(rng, r0, r1);
+          double fv = fj(v);
+          if (fv > logz && slice_doubling_accept(fj, x[j], v, l, r, w, logz, within_budget)) {
+            x[j] = v;
+            logy = fv;
+            accepted = true;
+            break;
+          }
+          shrinks++;
+          if (v < x[j])
+            r0 = v;
+          else
+            r1 = v;
+        }
+      } else {
+        if (budget > 0) {
+          // at most m steps in total, split at random between both directions
+          long long m = std::max(budget / 2, 1LL);
+          long long J = static_cast<long long>(m * rng.unif_rand()), K = m - 1 - J;
+          for (; J > 0 && L[j] > lower && f(L) > logz; J--, expansions++)
+            L[j] = L[j] - w;
+          for (; K > 0 && R[j] < upper && f(R) > logz; K--, expansions++)
+            R[j] = R[j] + w;
+        } else {
+          while ( L[j] > lower && f(L) > logz ) {
+            L[j] = L[j] - w;
+            expansions++;
+          }
+          while ( R[j] < upper && f(R) > logz ) {
+            R[j] = R[j] + w;
+            expansions++;
+          }
+        }
+
+        // sample until draw is within valid range
+        r0 = std::max(L[j], lower);
+        r1 = std::min(R[j], upper);
+
+        xs = x;
+        while (cnt < 1e4 && !out_of_budget()) {
+          cnt++;
+          xs[j] = slice_runif(rng, r0, r1);
+          logys = f(xs);
+          if ( logys > logz ) {
+            accepted = true;
+            break;
+          }
+          shrinks++;
+          if ( xs[j] < x[j] )
+            r0 = xs[j];
+          else
+            r1 = xs[j];
+        }
+        if (accepted) {
+          x = xs;
+          logy = logys;
+        }
+      }
+      // otherwise, the coordinate keeps its value
+      if (!accepted) exhausted++;
+    }
+  }
+
+  if (ctl != NULL) {
+    ctl->evals += evals;
+    ctl->draws += static_cast<long long>(steps) * D;
+    ctl->exhausted += exhausted;
+    ctl->expansions += expansions;
+    ctl->shrinks += shrinks;
+  }
+  return x;
+}
+
+template <std::size_t D, typename LogFn>
+std::array<double, D> slice_sample_cpp(LogFn logfn,
+                                       const std::array<double, D>& x0,
+                                       int steps = 10,
+                                       double w = 1,
+                                       double lower = -INFINITY,
+                                       double upper = INFINITY) {
+  RRng rng;
+  return slice_sample_cpp(logfn, x0, steps, w, lower, upper, rng);
+}
+
+// univariate convenience wrappers; `logfn` takes a plain double
+template <typename LogFn, typename Rng>
+double slice_sample_cpp(LogFn logfn,
+                        double x0,
+                        int steps,
+                        double w,
+                        double lower,
+                        double upper,
+                        Rng& rng,
+                        SliceControl* ctl = NULL) {
+  std::array<double, 1> x = {{x0}};
+  auto fn = [&logfn](const std::array<double, 1>& v) { return logfn(v[0]); };
+  return slice_sample_cpp(fn, x, steps, w, lower, upper, rng, ctl)[0];
+}
+
+template <typename LogFn>
+double slice_sample_cpp(LogFn logfn,
+                        double x0,
+                        int steps = 10,
+                        double w = 1,
+                        double lower = -INFINITY,
+                        double upper = INFINITY) {
+  RRng rng;
+  return slice_sample_cpp(logfn, x0, steps, w, lower, upper, rng);
+}
+
+
+// per-customer slice widths, that adapt to the posterior scale
+//
+// The default widths are derived from the cohort-level prior, and are thus
+// too narrow or too wide for customers whose posterior differs much from the
+// prior, e.g. heavy buyers, which makes the stepping-out and shrinkage loops
+// evaluate the log-density more often than needed. During burnin, a running
+// estimate of each customer's posterior standard deviation is kept via
+// Welford's algorithm, and once `min_draws` draws are seen, three times that
+// estimate is used as slice width, just as the default widths are three prior
+// standard deviations. The widths are frozen after burnin, so
+// that the returned draws are those of a Markov chain with fixed widths.
+class AdaptiveSliceWidth {
+public:
+  static const int min_draws = 10;
+
+  explicit AdaptiveSliceWidth(int N = 0) : n_(0), mean_(N), m2_(N) {}
+
+  // slice width for customer `i`, or the default width `w`, as long as there
+  // are too few draws
+  inline double width(int i, double w) const {
+    if (n_ < min_draws) return w;
+    double sd = sqrt(m2_[i] / (n_ - 1));
+    return (sd > 0 && std::isfinite(sd)) ? 3 * sd : w;
+  }
+
+  // adds the current draw `x` of customer `i`; all customers need to be
+  // updated, before the sweep is completed via next()
+  inline void update(int i, double x) {
+    double delta = x - mean_[i];
+    mean_[i] += delta / (n_ + 1);
+    m2_[i] += delta * (x - mean_[i]);
+  }
+
+  inline void next() { n_++; }
+
+private:
+  int n_;
+  std::vector<double> mean_, m2_;
+};
+
+
+// estimate parameters of gamma distribution
+
+inline double post_gamma_parameters(const std::array<double, 2>& log_data,
+                                    double len_x, double sum_x, double sum_log_x,
+                                    double hyper1, double hyper2, double hyper3, double hyper4) {
+  double shape = exp(log_data[0]);
+  double rate = exp(log_data[1]);
+  return len_x * (shape * log(rate) - lgamma(shape)) + (shape-1) * sum_log_x - rate * sum_x +
+    (hyper1 - 1) * log(shape) - (shape * hyper2) +
+    (hyper3 - 1) * log(rate) - (rate * hyper4);
+}
+
+// sufficient statistics of a sample of a gamma distribution
+struct GammaStats {
+  double n, sum_x, sum_log_x;
+};
+
+// GammaStats of the D arrays in `data`, each with N values, in a single pass
+// over the customers, as used for drawing the heterogeneity parameters of all
+// customer-level parameters of an MCMC step. With threads = 1 each sum is
+// accumulated in the same order as by summing the arrays one after the other,
+// so that results are unchanged; with more threads, each chunk of
+// GAMMA_STATS_CHUNK customers is summed with vectorized logarithms, and the
+// chunks are then combined in order, so that results do not depend on the
+// number of threads.
+const int GAMMA_STATS_CHUNK = 64 * SIMD_WIDTH;
+
+template <std::size_t D>
+std::array<GammaStats, D> gamma_stats(const std::array<const double*, D>& data, int N, int threads = 1) {
+  std::array<GammaStats, D> stats;
+  if (threads <= 1) {
+    std::array<double, D> sum_x, sum_log_x;
+    sum_x.fill(0);
+    sum_log_x.fill(0);
+    for (int i=0; i<N; i++) {
+      for (std::size_t d=0; d<D; d++) {
+        sum_x[d] += data[d][i];
+        sum_log_x[d] += log(data[d][i]);
+      }
+    }
+    for (std::size_t d=0; d<D; d++) stats[d] = {static_cast<double>(N), sum_x[d], sum_log_x[d]};
+    return stats;
+  }
+  const int W = SIMD_WIDTH;
+  int chunks = (N + GAMMA_STATS_CHUNK - 1) / GAMMA_STATS_CHUNK;
+  std::vector<std::array<double, 2 * D> > partial(chunks);
+  parallel_ranges(chunks, threads, [&](int, int chunk_begin, int chunk_end) {
+    double v[W], log_v[W];
+    for (int c = chunk_begin; c < chunk_end; c++) {
+      int begin = c * GAMMA_STATS_CHUNK, end = std::min(N, begin + GAMMA_STATS_CHUNK);
+      std::array<double, 2 * D>& sums = partial[c];
+      sums.fill(0);
+      for (std::size_t d=0; d<D; d++) {
+        const double* x = data[d];
+        int i = begin;
+        for (; i + W <= end; i += W) {
+          for (int j = 0; j < W; j++) v[j] = x[i + j];
+          simd_log(v, log_v);
+          for (int j = 0; j < W; j++) {
+            sums[2 * d] += v[j];
+            sums[2 * d + 1] += log_v[j];
+          }
+        }
+        for (; i < end; i++) {
+          sums[2 * d] += x[i];
+          sums[2 * d + 1] += log(x[i]);
+        }
+      }
+    }
+  });
+  for (std::size_t d=0; d<D; d++) {
+    stats[d] = {static_cast<double>(N), 0, 0};
+    for (int c=0; c<chunks; c++) {
+      stats[d].sum_x += partial[c][2 * d];
+      stats[d].sum_log_x += partial[c][2 * d + 1];
+    }
+  }
+  return stats;
+}
+
+// draws (shape, rate) of a gamma distribution, given the sufficient statistics
+// of its sample, the current (shape, rate) and the four hyper prior
+// parameters; the sampling is done on log scale, and `ctl` collects the
+// metrics of the slice sampler
+template <typename Rng>
+std::array<double, 2> slice_sample_gamma_parameters_cpp(const GammaStats& stats,
+                                                        double shape, double rate,
+                                                        const double* hyper,
+                                                        int steps, double w, Rng& rng,
+                                                        SliceControl* ctl = NULL) {
+  double hyper1 = hyper[0], hyper2 = hyper[1], hyper3 = hyper[2], hyper4 = hyper[3];
+  auto logfn = [&](const std::array<double, 2>& log_data) {
+    return post_gamma_parameters(log_data, stats.n, stats.sum_x, stats.sum_log_x, hyper1, hyper2, hyper3, hyper4);
+  };
+  std::array<double, 2> log_init = {{log(shape), log(rate)}};
+  std::array<double, 2> draw = slice_sample_cpp(logfn, log_init, steps, w, -INFINITY, INFINITY, rng, ctl);
+  return {{exp(draw[0]), exp(draw[1])}};
+}
+
+// as above, given the N values in `data`
+template <typename Rng>
+std::array<double, 2> slice_sample_gamma_parameters_cpp(const double* data, int N,
+                                                        double shape, double rate,
+                                                        const double* hyper,
+                                                        int steps, double w, Rng& rng) {
+  std::array<const double*, 1> arrays = {{data}};
+  return slice_sample_gamma_parameters_cpp(gamma_stats(arrays, N)[0], shape, rate, hyper, steps, w, rng);
+}
+
+#endif